@@ -0,0 +1,230 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include "chunk-manifest.h"
+#include "Sha1.h"
+#include <algorithm>
+#include <fstream>
+
+//chunks.r5hc layout, all values are little endian
+//Header
+//Record[fileCount] sorted by path then variant
+//Digest[digestCount], the chunks of each file back to back
+//Path bytes
+struct ChunkHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t chunkSize;
+	uint32_t fileCount;
+	uint32_t digestCount;
+	uint32_t pathsSize;
+	//FNV-1a of everything after the header
+	uint64_t checksum;
+};
+
+struct ChunkManifest::Record
+{
+	uint32_t pathOffset;
+	uint16_t pathLength;
+	Variant variant;
+	uint8_t reserved;
+	uint64_t size;
+	uint32_t firstDigest;
+	uint32_t digestCount;
+};
+
+static_assert(sizeof(ChunkHeader) == 32, "chunks.r5hc header layout changed");
+
+static const char chunkMagic[4] = { 'R', '5', 'H', 'K' };
+static const uint32_t chunkVersion = 1;
+
+bool ChunkManifest::Load(const fs::path& path)
+{
+	static_assert(sizeof(Record) == 24, "chunks.r5hc record layout changed");
+
+	records = nullptr;
+	recordCount = 0;
+
+	if (!mapped.Open(path))
+	{
+		return false;
+	}
+
+	const unsigned char* data = mapped.Data();
+	const ChunkHeader* header = (const ChunkHeader*)data;
+
+	bool valid = mapped.Size() >= sizeof(ChunkHeader)
+		&& memcmp(header->magic, chunkMagic, sizeof(chunkMagic)) == 0
+		&& header->version == chunkVersion
+		&& header->chunkSize == HashChunkSize
+		&& mapped.Size() == sizeof(ChunkHeader) + (size_t)header->fileCount * sizeof(Record) + (size_t)header->digestCount * sizeof(Digest) + header->pathsSize
+		&& header->checksum == Fnv1a(data + sizeof(ChunkHeader), mapped.Size() - sizeof(ChunkHeader));
+
+	if (!valid)
+	{
+		mapped.Close();
+		return false;
+	}
+
+	records = (const Record*)(data + sizeof(ChunkHeader));
+	recordCount = header->fileCount;
+	digests = (const Digest*)(records + recordCount);
+	paths = (const char*)(digests + header->digestCount);
+
+	//The checksum only catches damage, not a file that was written wrong
+	for (uint32_t i = 0; i < recordCount; i++)
+	{
+		if ((uint64_t)records[i].pathOffset + records[i].pathLength > header->pathsSize
+			|| (uint64_t)records[i].firstDigest + records[i].digestCount > header->digestCount)
+		{
+			records = nullptr;
+			recordCount = 0;
+			mapped.Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void ChunkManifest::Add(std::string_view path, Variant variant, uint64_t size, std::vector<Digest> chunks)
+{
+	built.push_back({ std::string(path), variant, size, std::move(chunks) });
+}
+
+bool ChunkManifest::Write(const fs::path& path)
+{
+	std::sort(built.begin(), built.end(), [](const BuiltChunks& a, const BuiltChunks& b)
+	{
+		return std::tie(a.path, a.variant) < std::tie(b.path, b.variant);
+	});
+
+	//Same rule as hashes.json, a file only becomes an SDK/Default pair if there is an SDK version
+	for (size_t i = 0; i < built.size(); i++)
+	{
+		bool hasSDK = i > 0 && built[i - 1].path == built[i].path && built[i - 1].variant == Variant::SDK;
+		if (built[i].variant == Variant::Default && !hasSDK)
+		{
+			built[i].variant = Variant::Any;
+		}
+	}
+
+	std::vector<Record> fileRecords;
+	std::vector<Digest> allDigests;
+	std::string allPaths;
+
+	for (const BuiltChunks& file : built)
+	{
+		//Record lengths are 16 bit, a longer path would be cut short
+		if (file.path.size() > UINT16_MAX)
+		{
+			return false;
+		}
+
+		Record record = {};
+		record.pathOffset = (uint32_t)allPaths.size();
+		record.pathLength = (uint16_t)file.path.size();
+		record.variant = file.variant;
+		record.size = file.size;
+		record.firstDigest = (uint32_t)allDigests.size();
+		record.digestCount = (uint32_t)file.chunks.size();
+
+		fileRecords.push_back(record);
+		allDigests.insert(allDigests.end(), file.chunks.begin(), file.chunks.end());
+		allPaths += file.path;
+	}
+
+	std::vector<unsigned char> out(sizeof(ChunkHeader));
+	out.insert(out.end(), (const unsigned char*)fileRecords.data(), (const unsigned char*)(fileRecords.data() + fileRecords.size()));
+	out.insert(out.end(), (const unsigned char*)allDigests.data(), (const unsigned char*)(allDigests.data() + allDigests.size()));
+	out.insert(out.end(), allPaths.begin(), allPaths.end());
+
+	ChunkHeader* header = (ChunkHeader*)out.data();
+	memcpy(header->magic, chunkMagic, sizeof(chunkMagic));
+	header->version = chunkVersion;
+	header->chunkSize = HashChunkSize;
+	header->fileCount = (uint32_t)fileRecords.size();
+	header->digestCount = (uint32_t)allDigests.size();
+	header->pathsSize = (uint32_t)allPaths.size();
+	header->checksum = Fnv1a(out.data() + sizeof(ChunkHeader), out.size() - sizeof(ChunkHeader));
+
+	return WriteFileAtomic(path, out.data(), out.size());
+}
+
+bool ChunkManifest::Find(std::string_view path, Variant variant, uint64_t& size, std::span<const Digest>& chunks) const
+{
+	auto key = [this](const Record& record) { return std::string_view(paths + record.pathOffset, record.pathLength); };
+
+	const Record* end = records + recordCount;
+	const Record* found = std::lower_bound(records, end, path, [&](const Record& record, std::string_view value) { return key(record) < value; });
+
+	for (; found != end && key(*found) == path; found++)
+	{
+		if (found->variant == variant)
+		{
+			size = found->size;
+			chunks = std::span<const Digest>(digests + found->firstDigest, found->digestCount);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool HashChunks(const fs::path& path, std::vector<Digest>& chunks, uint64_t& size)
+{
+	std::ifstream file_in(path, std::ios::in | std::ios::binary);
+	if (!file_in.good())
+	{
+		return false;
+	}
+
+	std::vector<char> buf(HashChunkSize);
+	CSha1* sha = new CSha1();
+
+	chunks.clear();
+	size = 0;
+
+	//The last chunk is short, which sets failbit along with eofbit
+	while (file_in.read(buf.data(), buf.size()) || file_in.gcount() > 0)
+	{
+		size_t read = (size_t)file_in.gcount();
+
+		Digest chunk;
+		Sha1_Init(sha);
+		Sha1_Update(sha, (const unsigned char*)buf.data(), read);
+		Sha1_Final(sha, chunk.bytes);
+
+		chunks.push_back(chunk);
+		size += read;
+	}
+
+	delete sha;
+	return file_in.eof();
+}
+
+std::vector<ByteRange> DamagedRanges(std::span<const Digest> expected, uint64_t expectedSize, const std::vector<Digest>& actual, uint64_t actualSize)
+{
+	std::vector<ByteRange> ranges;
+	size_t count = std::max(expected.size(), actual.size());
+
+	for (size_t i = 0; i < count; i++)
+	{
+		bool damaged = i >= expected.size() || i >= actual.size() || !(expected[i] == actual[i]);
+		if (!damaged)
+		{
+			continue;
+		}
+
+		uint64_t start = (uint64_t)i * HashChunkSize;
+		uint64_t end = std::min(start + HashChunkSize, std::max(expectedSize, actualSize));
+
+		if (!ranges.empty() && ranges.back().second == start)
+		{
+			ranges.back().second = end;
+		}
+		else
+		{
+			ranges.push_back({ start, end });
+		}
+	}
+
+	return ranges;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <experimental/filesystem>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "digest.h"
+#include "file-util.h"
+#include "manifest.h"
+
+namespace fs = std::experimental::filesystem;
+
+const uint32_t HashChunkSize = 1048576;
+
+//A byte range of a file, end is exclusive
+typedef std::pair<uint64_t, uint64_t> ByteRange;
+
+//Sha1 of every HashChunkSize bytes of the known good files, written by builder mode with --chunks to chunks.r5hc
+//Lets the checker tell which parts of a damaged file differ, see chunk-manifest.cpp for the layout
+class ChunkManifest
+{
+public:
+	//Maps chunks.r5hc, returns false if it is missing or corrupt
+	bool Load(const fs::path& path);
+
+	//Adds a file while building, files can be added in any order
+	void Add(std::string_view path, Variant variant, uint64_t size, std::vector<Digest> chunks);
+	//Files hashed from the SDK folder are SDK and everything else Default, Default files without an SDK version are written as Any like hashes.json
+	//Returns false without writing anything if a path is longer than 65535 bytes
+	bool Write(const fs::path& path);
+
+	//Returns false if the file has no chunk hashes
+	bool Find(std::string_view path, Variant variant, uint64_t& size, std::span<const Digest>& chunks) const;
+
+private:
+	struct Record;
+
+	struct BuiltChunks
+	{
+		std::string path;
+		Variant variant;
+		uint64_t size;
+		std::vector<Digest> chunks;
+	};
+
+	std::vector<BuiltChunks> built;
+
+	MappedFile mapped;
+	const Record* records = nullptr;
+	uint32_t recordCount = 0;
+	const Digest* digests = nullptr;
+	const char* paths = nullptr;
+};
+
+//Hashes a file in HashChunkSize chunks, returns false if it could not be read
+bool HashChunks(const fs::path& path, std::vector<Digest>& chunks, uint64_t& size);
+
+//Ranges of a file whose chunks differ from the expected ones, including anything past the end of the shorter of the two
+//Neighbouring damaged chunks are merged into one range
+std::vector<ByteRange> DamagedRanges(std::span<const Digest> expected, uint64_t expectedSize, const std::vector<Digest>& actual, uint64_t actualSize);
@@ -0,0 +1,261 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#define NOMINMAX
+#include "chunk-repair.h"
+#include "curl/curl.h"
+#include <windows.h>
+#include <algorithm>
+#include <fstream>
+
+//Largest piece of a range fetched at once
+const uint64_t FetchSize = 16 * 1048576;
+
+void RepairSource::Open(const std::string& source)
+{
+	url.clear();
+	folder.clear();
+
+	if (source.starts_with("http://") || source.starts_with("https://"))
+	{
+		url = source;
+		if (!url.ends_with("/"))
+		{
+			url += "/";
+		}
+		return;
+	}
+
+	std::string path = source;
+	if (path.starts_with("file://"))
+	{
+		path.erase(0, 7);
+
+		//file:///C:/mirror
+		if (path.size() > 2 && path[0] == '/' && path[2] == ':')
+		{
+			path.erase(0, 1);
+		}
+	}
+	folder = fs::u8path(path);
+}
+
+//Url of a file on the repair server, install paths use \ and urls /
+static std::string FileUrl(const std::string& base, std::string_view path)
+{
+	std::string fileUrl = base;
+	for (char c : path.substr(path.starts_with("\\") ? 1 : 0))
+	{
+		fileUrl += c == '\\' ? '/' : c;
+	}
+	return fileUrl;
+}
+
+static size_t StreamWriteCallback(char* pData, size_t size, size_t nmemb, void* puserData)
+{
+	std::ostream* out = (std::ostream*)puserData;
+	out->write(pData, size * nmemb);
+	return out->good() ? size * nmemb : 0;
+}
+
+//Where a range request is written, the response is dropped as soon as it is not the range that was asked for
+struct RangeResponse
+{
+	CURL* curl;
+	std::string* out;
+	size_t length;
+	//A 200 with the whole file is only usable if the range starts at 0
+	bool acceptWhole;
+};
+
+static size_t RangeWriteCallback(char* pData, size_t size, size_t nmemb, void* puserData)
+{
+	RangeResponse* response = (RangeResponse*)puserData;
+
+	//Headers have arrived by the first write, so a server that ignores the range is stopped before it sends the whole file
+	long status = 0;
+	curl_easy_getinfo(response->curl, CURLINFO_RESPONSE_CODE, &status);
+	if ((status != 206 && !(status == 200 && response->acceptWhole)) || response->out->size() + size * nmemb > response->length)
+	{
+		return 0;
+	}
+
+	response->out->append(pData, size * nmemb);
+	return size * nmemb;
+}
+
+bool RepairSource::Fetch(std::string_view path, ByteRange range, std::string& out)
+{
+	out.clear();
+
+	if (url.empty())
+	{
+		fs::path file = folder;
+		file += fs::u8path(std::string(path));
+
+		std::ifstream file_in(file, std::ios::in | std::ios::binary);
+		file_in.seekg((std::streamoff)range.first);
+		out.resize((size_t)(range.second - range.first));
+		file_in.read(out.data(), out.size());
+
+		return file_in.good() && (size_t)file_in.gcount() == out.size();
+	}
+
+	//Range requests use an inclusive end
+	std::string fileUrl = FileUrl(url, path);
+	std::string byteRange = std::to_string(range.first) + "-" + std::to_string(range.second - 1);
+
+	CURL* curl = curl_easy_init();
+	RangeResponse response = { curl, &out, (size_t)(range.second - range.first), range.first == 0 };
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, RangeWriteCallback);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+	curl_easy_setopt(curl, CURLOPT_URL, fileUrl.c_str());
+	curl_easy_setopt(curl, CURLOPT_RANGE, byteRange.c_str());
+	curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+
+	CURLcode ret = curl_easy_perform(curl);
+
+	long status = 0;
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+	curl_easy_cleanup(curl);
+
+	//A server that ignores the range sends the whole file with 200, which is only usable if that is what was asked for
+	return ret == CURLE_OK && (status == 206 || (status == 200 && range.first == 0)) && out.size() == range.second - range.first;
+}
+
+bool RepairSource::FetchFile(std::string_view path, const fs::path& destination)
+{
+	if (url.empty())
+	{
+		fs::path file = folder;
+		file += fs::u8path(std::string(path));
+
+		std::error_code ec;
+		fs::copy_file(file, destination, fs::copy_options::overwrite_existing, ec);
+		return !ec;
+	}
+
+	std::ofstream file_out(destination, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file_out.good())
+	{
+		return false;
+	}
+
+	std::string fileUrl = FileUrl(url, path);
+
+	CURL* curl = curl_easy_init();
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, StreamWriteCallback);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, (std::ostream*)&file_out);
+	curl_easy_setopt(curl, CURLOPT_URL, fileUrl.c_str());
+	curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+
+	CURLcode ret = curl_easy_perform(curl);
+	curl_easy_cleanup(curl);
+
+	file_out.close();
+	return !file_out.fail() && ret == CURLE_OK;
+}
+
+//Moves a finished repair over the damaged file, or removes it if the repair failed so the damaged file is left as it was
+static bool ReplaceWithRepair(const fs::path& temp, const fs::path& file, bool ok)
+{
+	if (!ok || !MoveFileExW(temp.wstring().c_str(), file.wstring().c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		std::error_code ec;
+		fs::remove(temp, ec);
+		return false;
+	}
+	return true;
+}
+
+//Calls patch for each FetchSize piece of the ranges that lies inside a file of size bytes, stops at the first that returns false
+template <typename Patch>
+static bool ForEachPiece(const std::vector<ByteRange>& ranges, uint64_t size, Patch&& patch)
+{
+	for (const ByteRange& range : ranges)
+	{
+		//Ranges past the end of a file that was too long are already gone
+		uint64_t end = std::min(range.second, size);
+
+		for (uint64_t start = range.first; start < end; start += FetchSize)
+		{
+			if (!patch(ByteRange{ start, std::min(start + FetchSize, end) }))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool RepairRanges(RepairSource& source, const fs::path& file, std::string_view path, const std::vector<ByteRange>& ranges, uint64_t size)
+{
+	//Every range is downloaded into a journal next to the file first, so a failed fetch leaves the file as it was
+	fs::path journal_path = file;
+	journal_path += ".repair";
+
+	//Missing files can be in folders that are missing too
+	std::error_code ec;
+	fs::create_directories(file.parent_path(), ec);
+
+	std::string data;
+	bool fetched;
+	{
+		std::ofstream journal(journal_path, std::ios::out | std::ios::binary | std::ios::trunc);
+		fetched = journal.good() && ForEachPiece(ranges, size, [&](ByteRange piece)
+		{
+			return source.Fetch(path, piece, data) && journal.write(data.data(), data.size()).good();
+		});
+
+		journal.close();
+		fetched = fetched && !journal.fail();
+	}
+
+	if (!fetched)
+	{
+		fs::remove(journal_path, ec);
+		return false;
+	}
+
+	//The file is already known to be damaged and is checked again afterwards, so it is patched in place
+	if (!fs::exists(file))
+	{
+		std::ofstream create(file, std::ios::out | std::ios::binary);
+	}
+
+	fs::resize_file(file, size, ec);
+
+	bool ok = !ec;
+	{
+		std::ifstream journal(journal_path, std::ios::in | std::ios::binary);
+		std::fstream file_io(file, std::ios::in | std::ios::out | std::ios::binary);
+
+		ok = ok && journal.good() && file_io.good() && ForEachPiece(ranges, size, [&](ByteRange piece)
+		{
+			data.resize((size_t)(piece.second - piece.first));
+			journal.read(data.data(), data.size());
+
+			file_io.seekp((std::streamoff)piece.first);
+			file_io.write(data.data(), data.size());
+			return journal.good() && file_io.good();
+		});
+
+		file_io.flush();
+		ok = ok && file_io.good();
+	}
+
+	fs::remove(journal_path, ec);
+	return ok;
+}
+
+bool RepairWholeFile(RepairSource& source, const fs::path& file, std::string_view path)
+{
+	fs::path temp = file;
+	temp += ".repair";
+
+	//Missing files can be in folders that are missing too
+	std::error_code ec;
+	fs::create_directories(file.parent_path(), ec);
+
+	return ReplaceWithRepair(temp, file, source.FetchFile(path, temp));
+}
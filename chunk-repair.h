@@ -0,0 +1,34 @@
+#pragma once
+#include <experimental/filesystem>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "chunk-manifest.h"
+
+namespace fs = std::experimental::filesystem;
+
+//Where repairs are read from, either a http(s) url fetched with range requests or a folder laid out like the install
+//file:// urls are treated as folders
+class RepairSource
+{
+public:
+	void Open(const std::string& source);
+
+	//Reads range of the file at path, a path from the install folder like \paks\Win64\common.rpak
+	bool Fetch(std::string_view path, ByteRange range, std::string& out);
+	//Copies the whole file at path to destination
+	bool FetchFile(std::string_view path, const fs::path& destination);
+
+private:
+	std::string url;
+	fs::path folder;
+};
+
+//Overwrites the damaged ranges of file with data from source then sets it to size bytes
+//Every range is fetched before file is touched, so a failed fetch leaves it unchanged
+//Ranges are fetched in pieces so large ranges are not held in memory at once
+bool RepairRanges(RepairSource& source, const fs::path& file, std::string_view path, const std::vector<ByteRange>& ranges, uint64_t size);
+
+//Replaces file with a complete copy from source, used when there are no chunk hashes to narrow the damage down
+bool RepairWholeFile(RepairSource& source, const fs::path& file, std::string_view path);
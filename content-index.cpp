@@ -0,0 +1,62 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include "content-index.h"
+#include <algorithm>
+
+void ContentIndex::Add(std::string_view path, const FileIdentity& identity, const Digest& digest)
+{
+	if (added.insert({ identity.device, identity.inode, std::string(path) }).second)
+	{
+		files.push_back({ std::string(path), identity, digest });
+	}
+}
+
+std::vector<DuplicateGroup> ContentIndex::Duplicates() const
+{
+	//Sorting by content then file puts every group together with its hard links next to each other
+	std::vector<const IndexedFile*> sorted;
+	sorted.reserve(files.size());
+	for (const IndexedFile& file : files)
+	{
+		sorted.push_back(&file);
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](const IndexedFile* a, const IndexedFile* b)
+	{
+		int order = memcmp(a->digest.bytes, b->digest.bytes, sizeof(a->digest.bytes));
+		if (order != 0)
+		{
+			return order < 0;
+		}
+		return std::tie(a->identity.device, a->identity.inode, a->path) < std::tie(b->identity.device, b->identity.inode, b->path);
+	});
+
+	std::vector<DuplicateGroup> groups;
+
+	for (size_t i = 0; i < sorted.size();)
+	{
+		DuplicateGroup group;
+		group.digest = sorted[i]->digest;
+		group.size = sorted[i]->identity.size;
+
+		for (; i < sorted.size() && sorted[i]->digest == group.digest; i++)
+		{
+			const IndexedFile* previous = group.files.empty() ? nullptr : group.files.back();
+			if (previous == nullptr || previous->identity.device != sorted[i]->identity.device || previous->identity.inode != sorted[i]->identity.inode)
+			{
+				group.copies++;
+			}
+			group.files.push_back(sorted[i]);
+		}
+
+		//Empty files all have the same hash but nothing to reclaim
+		if (group.copies > 1 && group.size != 0)
+		{
+			group.reclaimable = group.size * (group.copies - 1);
+			groups.push_back(std::move(group));
+		}
+	}
+
+	std::stable_sort(groups.begin(), groups.end(), [](const DuplicateGroup& a, const DuplicateGroup& b) { return a.reclaimable > b.reclaimable; });
+
+	return groups;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "digest.h"
+#include "hash-cache.h"
+
+//A hashed file, path is shown as given so files from other installs can carry their install folder
+struct IndexedFile
+{
+	std::string path;
+	FileIdentity identity;
+	Digest digest;
+};
+
+//Files with the same content stored more than once
+struct DuplicateGroup
+{
+	Digest digest;
+	uint64_t size = 0;
+	std::vector<const IndexedFile*> files;
+	//Distinct copies on disk, hard links to the same file count once
+	size_t copies = 0;
+	//Bytes freed if every copy but one was replaced by a hard link
+	uint64_t reclaimable = 0;
+};
+
+//Indexes hashed files by content to find duplicates within and across installs
+class ContentIndex
+{
+public:
+	//The same path of the same file is only added once, so results and cache records can both be added
+	void Add(std::string_view path, const FileIdentity& identity, const Digest& digest);
+
+	size_t Count() const { return files.size(); }
+
+	//Groups with more than one copy on disk, most reclaimable bytes first
+	//The groups point into the index and are invalidated by Add
+	std::vector<DuplicateGroup> Duplicates() const;
+
+private:
+	std::vector<IndexedFile> files;
+	std::set<std::tuple<uint64_t, uint64_t, std::string>> added;
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstring>
+#include <string>
+#include <string_view>
+
+//Raw sha1 of a file
+struct Digest
+{
+	unsigned char bytes[20] = {};
+
+	bool operator==(const Digest& other) const
+	{
+		return memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+	}
+
+	std::string ToHex() const
+	{
+		static const char digits[] = "0123456789abcdef";
+		std::string hex(sizeof(bytes) * 2, '0');
+		for (size_t i = 0; i < sizeof(bytes); i++)
+		{
+			hex[i * 2] = digits[bytes[i] >> 4];
+			hex[i * 2 + 1] = digits[bytes[i] & 0xf];
+		}
+		return hex;
+	}
+
+	//Parses the 40 character hex form used in hashes.json, returns false if hex is not a valid sha1
+	static bool FromHex(std::string_view hex, Digest& out)
+	{
+		if (hex.size() != sizeof(out.bytes) * 2)
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < hex.size(); i++)
+		{
+			char c = hex[i];
+			int nibble;
+
+			if (c >= '0' && c <= '9')
+			{
+				nibble = c - '0';
+			}
+			else if (c >= 'a' && c <= 'f')
+			{
+				nibble = c - 'a' + 10;
+			}
+			else if (c >= 'A' && c <= 'F')
+			{
+				nibble = c - 'A' + 10;
+			}
+			else
+			{
+				return false;
+			}
+
+			if (i % 2 == 0)
+			{
+				out.bytes[i / 2] = (unsigned char)(nibble << 4);
+			}
+			else
+			{
+				out.bytes[i / 2] |= (unsigned char)nibble;
+			}
+		}
+		return true;
+	}
+};
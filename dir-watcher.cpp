@@ -0,0 +1,71 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#define NOMINMAX
+#include "dir-watcher.h"
+#include <windows.h>
+
+//Large enough to hold a burst of changes from an update, ReadDirectoryChangesW reports an overflow past this
+const size_t WatchBufferSize = 64 * 1024;
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+	if (directory != nullptr)
+	{
+		CloseHandle(directory);
+	}
+}
+
+bool DirectoryWatcher::Open(const fs::path& root)
+{
+	directory = CreateFileW(root.wstring().c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+
+	if (directory == INVALID_HANDLE_VALUE)
+	{
+		directory = nullptr;
+		return false;
+	}
+
+	buffer.resize(WatchBufferSize);
+	return true;
+}
+
+bool DirectoryWatcher::Wait(std::vector<std::string>& changed, bool& overflow)
+{
+	changed.clear();
+	overflow = false;
+
+	DWORD bytes = 0;
+	const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
+
+	if (!ReadDirectoryChangesW(directory, buffer.data(), (DWORD)buffer.size(), TRUE, filter, &bytes, nullptr, nullptr))
+	{
+		return false;
+	}
+
+	//Zero bytes means the changes did not fit in the buffer and were dropped
+	if (bytes == 0)
+	{
+		overflow = true;
+		return true;
+	}
+
+	size_t offset = 0;
+
+	while (true)
+	{
+		const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)&buffer[offset];
+		int length = (int)(info->FileNameLength / sizeof(wchar_t));
+
+		std::string name(WideCharToMultiByte(CP_UTF8, 0, info->FileName, length, nullptr, 0, nullptr, nullptr), '\0');
+		WideCharToMultiByte(CP_UTF8, 0, info->FileName, length, name.data(), (int)name.size(), nullptr, nullptr);
+
+		changed.push_back("\\" + name);
+
+		if (info->NextEntryOffset == 0)
+		{
+			break;
+		}
+		offset += info->NextEntryOffset;
+	}
+
+	return true;
+}
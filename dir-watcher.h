@@ -0,0 +1,28 @@
+#pragma once
+#include <experimental/filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::experimental::filesystem;
+
+//Reports files that are created, modified, deleted or renamed anywhere below a directory
+class DirectoryWatcher
+{
+public:
+	DirectoryWatcher() = default;
+	~DirectoryWatcher();
+
+	DirectoryWatcher(const DirectoryWatcher&) = delete;
+	DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+	bool Open(const fs::path& root);
+
+	//Blocks until something changes and sets changed to the affected paths in "\\dir\\file" form relative to the root
+	//overflow is set when too many changes happened to report individually and everything should be rechecked
+	//Returns false if the directory can no longer be watched
+	bool Wait(std::vector<std::string>& changed, bool& overflow);
+
+private:
+	void* directory = nullptr;
+	std::vector<unsigned char> buffer;
+};
@@ -0,0 +1,149 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#define NOMINMAX
+#include "file-util.h"
+#include <windows.h>
+#include <string>
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		std::swap(file, other.file);
+		std::swap(mapping, other.mapping);
+		std::swap(view, other.view);
+		std::swap(size, other.size);
+	}
+	return *this;
+}
+
+bool MappedFile::Open(const fs::path& path)
+{
+	Close();
+
+	file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		file = nullptr;
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+
+	//Empty files cannot be mapped
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	if (mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (view == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (view != nullptr)
+	{
+		UnmapViewOfFile(view);
+		view = nullptr;
+	}
+
+	if (mapping != nullptr)
+	{
+		CloseHandle(mapping);
+		mapping = nullptr;
+	}
+
+	if (file != nullptr)
+	{
+		CloseHandle(file);
+		file = nullptr;
+	}
+
+	size = 0;
+}
+
+bool WriteFileAtomic(const fs::path& path, const void* data, size_t size)
+{
+	fs::path temp_path = path;
+	temp_path += ".tmp";
+
+	HANDLE file = CreateFileW(temp_path.wstring().c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	const unsigned char* pos = (const unsigned char*)data;
+	size_t remaining = size;
+	bool ok = true;
+
+	while (ok && remaining > 0)
+	{
+		DWORD chunk = remaining > 0x40000000 ? 0x40000000 : (DWORD)remaining;
+		DWORD written = 0;
+
+		ok = WriteFile(file, pos, chunk, &written, nullptr) && written == chunk;
+		pos += written;
+		remaining -= written;
+	}
+
+	//Make sure the data is on disk before the rename makes it visible
+	ok = ok && FlushFileBuffers(file);
+	CloseHandle(file);
+
+	if (!ok || !MoveFileExW(temp_path.wstring().c_str(), path.wstring().c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+	{
+		std::error_code ec;
+		fs::remove(temp_path, ec);
+		return false;
+	}
+
+	return true;
+}
+
+uint64_t Fnv1a(const unsigned char* data, size_t size)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= data[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+size_t StringWriteCallback(char* pData, size_t size, size_t nmemb, void* puserData)
+{
+	((std::string*)puserData)->append(pData, size * nmemb);
+	return size * nmemb;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <experimental/filesystem>
+#include <cstddef>
+#include <cstdint>
+
+namespace fs = std::experimental::filesystem;
+
+//Read only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	//The view stays at the same address when moved so pointers into it stay valid
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	//Maps the file into memory, returns false if it does not exist or could not be mapped
+	bool Open(const fs::path& path);
+	void Close();
+
+	const unsigned char* Data() const { return (const unsigned char*)view; }
+	size_t Size() const { return size; }
+
+private:
+	void* file = nullptr;
+	void* mapping = nullptr;
+	void* view = nullptr;
+	size_t size = 0;
+};
+
+//Writes data to a temporary file next to path then renames it over path
+//Readers will either see the old file or the complete new one, never a partial write
+bool WriteFileAtomic(const fs::path& path, const void* data, size_t size);
+
+//64 bit FNV-1a, the checksum stored in the headers of hashcache.bin, hashes.r5hm, chunks.r5hc and vpkentries.r5hv
+//New binary formats should checksum with this rather than their own copy
+uint64_t Fnv1a(const unsigned char* data, size_t size);
+
+//Curl write callback that appends to the std::string passed as CURLOPT_WRITEDATA
+size_t StringWriteCallback(char* pData, size_t size, size_t nmemb, void* puserData);
@@ -0,0 +1,279 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#define NOMINMAX
+#include "hash-cache.h"
+#include "digest.h"
+#include <algorithm>
+#include <cstring>
+#include <windows.h>
+
+//Cache file layout, all values are little endian
+//Header
+//Record[recordCount] sorted by device then inode
+//String table of null terminated paths, referenced by Record::pathOffset
+struct CacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t recordCount;
+	uint32_t stringsSize;
+	//FNV-1a of everything after the header
+	uint64_t checksum;
+	uint64_t reserved;
+};
+
+struct HashCache::Record
+{
+	uint64_t device;
+	uint64_t inode;
+	uint64_t size;
+	int64_t mtime_ns;
+	int64_t ctime_ns;
+	Digest hash;
+	uint32_t pathOffset;
+};
+
+static_assert(sizeof(CacheHeader) == 32, "Cache header layout changed");
+
+static const char cacheMagic[4] = { 'R', '5', 'H', 'C' };
+static const uint32_t cacheVersion = 1;
+
+//FILETIME and FILE_BASIC_INFO times are in 100ns intervals
+static int64_t TicksToNs(int64_t ticks)
+{
+	return ticks * 100;
+}
+
+bool GetFileIdentity(const fs::path& path, FileIdentity& out)
+{
+	//Opening with no access rights only reads metadata and does not block other readers/writers
+	HANDLE file = CreateFileW(path.wstring().c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	BY_HANDLE_FILE_INFORMATION info;
+	FILE_BASIC_INFO basic;
+
+	bool ok = GetFileInformationByHandle(file, &info) && GetFileInformationByHandleEx(file, FileBasicInfo, &basic, sizeof(basic));
+	CloseHandle(file);
+
+	if (!ok)
+	{
+		return false;
+	}
+
+	out.device = info.dwVolumeSerialNumber;
+	out.inode = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+	out.size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+	out.mtime_ns = TicksToNs(basic.LastWriteTime.QuadPart);
+	out.ctime_ns = TicksToNs(basic.ChangeTime.QuadPart);
+
+	return true;
+}
+
+void HashCache::Load(const fs::path& path)
+{
+	static_assert(sizeof(Record) == 64, "Cache record layout changed");
+
+	records = nullptr;
+	recordCount = 0;
+	strings = nullptr;
+	stringsSize = 0;
+	used.clear();
+	updated.clear();
+
+	if (!mapped.Open(path))
+	{
+		return;
+	}
+
+	const unsigned char* data = mapped.Data();
+	const CacheHeader* header = (const CacheHeader*)data;
+
+	bool valid = mapped.Size() >= sizeof(CacheHeader)
+		&& memcmp(header->magic, cacheMagic, sizeof(cacheMagic)) == 0
+		&& header->version == cacheVersion
+		&& mapped.Size() == sizeof(CacheHeader) + (size_t)header->recordCount * sizeof(Record) + header->stringsSize
+		&& header->checksum == Fnv1a(data + sizeof(CacheHeader), mapped.Size() - sizeof(CacheHeader));
+
+	if (!valid)
+	{
+		//Treat a bad cache as empty, it will be replaced on save
+		mapped.Close();
+		return;
+	}
+
+	records = (const Record*)(data + sizeof(CacheHeader));
+	recordCount = header->recordCount;
+	strings = (const char*)(records + recordCount);
+	stringsSize = header->stringsSize;
+	used.assign(recordCount, false);
+}
+
+bool HashCache::Save(const fs::path& path, bool prune)
+{
+	//Merge the mapped records that are still wanted with the entries from this run
+	std::vector<Entry> entries;
+	entries.reserve(recordCount + updated.size());
+
+	for (size_t i = 0; i < recordCount; i++)
+	{
+		const Record& record = records[i];
+
+		if ((prune && !used[i]) || updated.contains({ record.device, record.inode }))
+		{
+			continue;
+		}
+
+		Entry entry;
+		entry.id = { record.device, record.inode, record.size, record.mtime_ns, record.ctime_ns };
+		if (record.pathOffset < stringsSize)
+		{
+			entry.path.assign(strings + record.pathOffset, strnlen(strings + record.pathOffset, stringsSize - record.pathOffset));
+		}
+		entry.hash = record.hash.ToHex();
+		entries.push_back(std::move(entry));
+	}
+
+	for (const auto& [key, entry] : updated)
+	{
+		entries.push_back(entry);
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b)
+	{
+		return std::tie(a.id.device, a.id.inode) < std::tie(b.id.device, b.id.inode);
+	});
+
+	std::string stringTable;
+	std::vector<Record> out(entries.size());
+
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		const Entry& entry = entries[i];
+		Record& record = out[i];
+
+		record = { entry.id.device, entry.id.inode, entry.id.size, entry.id.mtime_ns, entry.id.ctime_ns, {}, (uint32_t)stringTable.size() };
+		Digest::FromHex(entry.hash, record.hash);
+
+		stringTable += entry.path;
+		stringTable += '\0';
+	}
+
+	std::vector<unsigned char> file(sizeof(CacheHeader) + out.size() * sizeof(Record) + stringTable.size());
+
+	CacheHeader* header = (CacheHeader*)file.data();
+	memcpy(header->magic, cacheMagic, sizeof(cacheMagic));
+	header->version = cacheVersion;
+	header->recordCount = (uint32_t)out.size();
+	header->stringsSize = (uint32_t)stringTable.size();
+	header->reserved = 0;
+
+	if (!out.empty())
+	{
+		memcpy(file.data() + sizeof(CacheHeader), out.data(), out.size() * sizeof(Record));
+	}
+	memcpy(file.data() + sizeof(CacheHeader) + out.size() * sizeof(Record), stringTable.data(), stringTable.size());
+	header->checksum = Fnv1a(file.data() + sizeof(CacheHeader), file.size() - sizeof(CacheHeader));
+
+	//The old cache has to be unmapped before it can be replaced
+	records = nullptr;
+	recordCount = 0;
+	strings = nullptr;
+	stringsSize = 0;
+	used.clear();
+	mapped.Close();
+
+	return WriteFileAtomic(path, file.data(), file.size());
+}
+
+const HashCache::Record* HashCache::FindRecord(const FileIdentity& id) const
+{
+	const Record* end = records + recordCount;
+	const Record* record = std::lower_bound(records, end, id, [](const Record& r, const FileIdentity& key)
+	{
+		return std::tie(r.device, r.inode) < std::tie(key.device, key.inode);
+	});
+
+	if (record == end || record->device != id.device || record->inode != id.inode
+		|| record->size != id.size || record->mtime_ns != id.mtime_ns || record->ctime_ns != id.ctime_ns)
+	{
+		return nullptr;
+	}
+	return record;
+}
+
+bool HashCache::Lookup(const FileIdentity& id, std::string& hash)
+{
+	//Entries from this run take priority over the mapped file
+	auto found = updated.find({ id.device, id.inode });
+
+	if (found != updated.end())
+	{
+		if (found->second.id == id)
+		{
+			hash = found->second.hash;
+			hits++;
+			return true;
+		}
+
+		misses++;
+		return false;
+	}
+
+	const Record* record = FindRecord(id);
+	if (record == nullptr)
+	{
+		misses++;
+		return false;
+	}
+
+	used[record - records] = true;
+	hash = record->hash.ToHex();
+	hits++;
+	return true;
+}
+
+bool HashCache::Peek(const FileIdentity& id, Digest& digest) const
+{
+	auto found = updated.find({ id.device, id.inode });
+
+	if (found != updated.end())
+	{
+		return found->second.id == id && Digest::FromHex(found->second.hash, digest);
+	}
+
+	const Record* record = FindRecord(id);
+	if (record == nullptr)
+	{
+		return false;
+	}
+
+	digest = record->hash;
+	return true;
+}
+
+void HashCache::Store(const FileIdentity& id, const std::string& path, const std::string& hash)
+{
+	Entry& entry = updated[{ id.device, id.inode }];
+	entry.id = id;
+	entry.path = path;
+	entry.hash = hash;
+}
+
+void HashCache::ForEach(const std::function<void(const FileIdentity&, std::string_view, const Digest&)>& visit) const
+{
+	for (size_t i = 0; i < recordCount; i++)
+	{
+		const Record& record = records[i];
+		if (record.pathOffset >= stringsSize)
+		{
+			continue;
+		}
+
+		FileIdentity id{ record.device, record.inode, record.size, record.mtime_ns, record.ctime_ns };
+		visit(id, std::string_view(strings + record.pathOffset, strnlen(strings + record.pathOffset, stringsSize - record.pathOffset)), record.hash);
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <experimental/filesystem>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "digest.h"
+#include "file-util.h"
+
+namespace fs = std::experimental::filesystem;
+
+//Everything needed to tell whether a file has changed since it was last hashed
+struct FileIdentity
+{
+	uint64_t device = 0;
+	uint64_t inode = 0;
+	uint64_t size = 0;
+	int64_t mtime_ns = 0;
+	int64_t ctime_ns = 0;
+
+	bool operator==(const FileIdentity&) const = default;
+};
+
+//Reads the identity of a file without opening it for reading, returns false if the file could not be queried
+bool GetFileIdentity(const fs::path& path, FileIdentity& out);
+
+//Maps a file identity to the hash computed for it on a previous run so unchanged files can skip hashing
+//The cache file is memory mapped and searched in place, see hash-cache.cpp for the layout
+class HashCache
+{
+public:
+	//Maps the cache file, a missing or corrupt cache file just starts an empty cache
+	//Entries stored since the last save are discarded
+	void Load(const fs::path& path);
+
+	//Writes the cache to disk, if prune is set only entries used during this run are kept
+	//This unmaps the loaded cache file so it should be called once at the end of a run
+	bool Save(const fs::path& path, bool prune);
+
+	//Returns true and sets hash if the file has not changed since it was cached
+	bool Lookup(const FileIdentity& id, std::string& hash);
+	//Same as Lookup, but the entry is not counted or marked as used, for deciding whether a file needs more than a lookup
+	bool Peek(const FileIdentity& id, Digest& digest) const;
+
+	void Store(const FileIdentity& id, const std::string& path, const std::string& hash);
+
+	//Calls visit(identity, path, hash) for every record in the loaded cache file, entries stored since it was loaded are not visited
+	void ForEach(const std::function<void(const FileIdentity&, std::string_view, const Digest&)>& visit) const;
+
+	size_t Hits() const { return hits; }
+	size_t Misses() const { return misses; }
+
+private:
+	struct Record;
+
+	//Returns the mapped record for a file that has not changed since it was cached, or nullptr
+	const Record* FindRecord(const FileIdentity& id) const;
+
+	struct Entry
+	{
+		FileIdentity id;
+		std::string path;
+		std::string hash;
+	};
+
+	MappedFile mapped;
+	const Record* records = nullptr;
+	size_t recordCount = 0;
+	const char* strings = nullptr;
+	size_t stringsSize = 0;
+	//Which mapped records were looked up during this run
+	std::vector<bool> used;
+
+	//Entries hashed during this run, these replace mapped records with the same device and inode
+	std::map<std::pair<uint64_t, uint64_t>, Entry> updated;
+
+	size_t hits = 0;
+	size_t misses = 0;
+};
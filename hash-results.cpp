@@ -0,0 +1,67 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include "hash-results.h"
+#include <algorithm>
+
+uint32_t HashResults::Add(const Manifest& manifest, std::string_view path, const Digest& digest)
+{
+	uint32_t id;
+	if (!manifest.FindPath(path, id))
+	{
+		id = manifest.PathCount() + extraCount++;
+	}
+
+	if (!sorted)
+	{
+		results.push_back({ id, digest });
+		return id;
+	}
+
+	//A file hashed again, like one rechecked by --watch, has its hash replaced in place
+	auto position = std::lower_bound(results.begin(), results.end(), id, [](const Result& result, uint32_t pathId) { return result.pathId < pathId; });
+	if (position != results.end() && position->pathId == id)
+	{
+		position->digest = digest;
+	}
+	else
+	{
+		results.insert(position, { id, digest });
+	}
+	return id;
+}
+
+void HashResults::Remove(uint32_t pathId)
+{
+	if (!sorted)
+	{
+		results.erase(std::remove_if(results.begin(), results.end(), [pathId](const Result& result) { return result.pathId == pathId; }), results.end());
+		return;
+	}
+
+	auto found = std::lower_bound(results.begin(), results.end(), pathId, [](const Result& result, uint32_t id) { return result.pathId < id; });
+	if (found != results.end() && found->pathId == pathId)
+	{
+		results.erase(found);
+	}
+}
+
+void HashResults::Sort()
+{
+	//Later results for the same file replace earlier ones
+	std::stable_sort(results.begin(), results.end(), [](const Result& a, const Result& b) { return a.pathId < b.pathId; });
+
+	auto last = std::unique(results.rbegin(), results.rend(), [](const Result& a, const Result& b) { return a.pathId == b.pathId; });
+	results.erase(results.begin(), last.base());
+
+	sorted = true;
+}
+
+const Digest* HashResults::Find(uint32_t pathId) const
+{
+	auto found = std::lower_bound(results.begin(), results.end(), pathId, [](const Result& result, uint32_t id) { return result.pathId < id; });
+
+	if (found == results.end() || found->pathId != pathId)
+	{
+		return nullptr;
+	}
+	return &found->digest;
+}
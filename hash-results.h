@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "digest.h"
+#include "manifest.h"
+
+//What the comparison found wrong with a file
+enum class Outcome
+{
+	//In the manifest for this install but not found
+	Missing,
+	//Found with a different hash
+	Mismatch,
+	//Found but not in the manifest at all
+	Extra
+};
+
+//Hashes of the files found in the install, keyed by manifest path id so they can be compared against the manifest in one pass
+//Files that are not in the manifest are given ids after the last manifest path
+class HashResults
+{
+public:
+	//Appends while the install is being hashed, once sorted new results are inserted in order and a file already there has its hash replaced
+	//Returns the path id given to the file
+	uint32_t Add(const Manifest& manifest, std::string_view path, const Digest& digest);
+	void Remove(uint32_t pathId);
+	void Sort();
+
+	//Returns nullptr if the file was not found, only valid once sorted
+	const Digest* Find(uint32_t pathId) const;
+
+	//Walks the manifest and the sorted results together, calling report(outcome, pathId) for every file that is not as expected
+	//Does not allocate
+	template <typename Report>
+	void Compare(const Manifest& manifest, bool bHasSDK, Report&& report) const
+	{
+		size_t r = 0;
+
+		for (uint32_t id = 0; id < manifest.PathCount(); id++)
+		{
+			//Results for a path come after every path with a lower id, those without a manifest path are extras
+			while (r < results.size() && results[r].pathId < id)
+			{
+				r++;
+			}
+
+			const ManifestEntry* expected = manifest.Select(id, bHasSDK);
+			if (expected == nullptr)
+			{
+				continue;
+			}
+
+			if (r == results.size() || results[r].pathId != id)
+			{
+				report(Outcome::Missing, id);
+			}
+			else if (!(results[r].digest == expected->digest))
+			{
+				report(Outcome::Mismatch, id);
+			}
+		}
+
+		for (; r < results.size(); r++)
+		{
+			if (results[r].pathId >= manifest.PathCount())
+			{
+				report(Outcome::Extra, results[r].pathId);
+			}
+		}
+	}
+
+private:
+	struct Result
+	{
+		uint32_t pathId;
+		Digest digest;
+	};
+
+	std::vector<Result> results;
+	//Files not in the manifest seen so far, each is given the next id after the manifest paths
+	uint32_t extraCount = 0;
+	bool sorted = false;
+};
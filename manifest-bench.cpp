@@ -0,0 +1,131 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+//#define MANIFEST_BENCH
+#include "manifest-bench.h"
+#include "manifest.h"
+#include "Include/nlohmann/json.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+static std::atomic<size_t> heapCurrent = 0;
+static std::atomic<size_t> heapPeak = 0;
+
+#ifdef MANIFEST_BENCH
+//Counts every heap allocation in the process, each block is prefixed with its size so delete knows how much to subtract
+//This slows down every allocation so it is only built in when benchmarking
+static const size_t HeaderSize = alignof(std::max_align_t);
+
+void* operator new(size_t size)
+{
+	unsigned char* block = (unsigned char*)malloc(size + HeaderSize);
+	if (block == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+
+	*(size_t*)block = size;
+
+	size_t current = heapCurrent += size;
+	size_t peak = heapPeak;
+	while (current > peak && !heapPeak.compare_exchange_weak(peak, current))
+	{
+	}
+
+	return block + HeaderSize;
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if (ptr == nullptr)
+	{
+		return;
+	}
+
+	unsigned char* block = (unsigned char*)ptr - HeaderSize;
+	heapCurrent -= *(size_t*)block;
+	free(block);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	operator delete(ptr);
+}
+#endif
+
+//Resets the peak to the current heap use so the next measurement only counts what happens after this
+static size_t StartHeapMeasure()
+{
+	heapPeak = heapCurrent.load();
+	return heapCurrent;
+}
+
+template <typename Load>
+static void Measure(const char* name, int iterations, Load load)
+{
+	using clock = std::chrono::steady_clock;
+
+	size_t base = StartHeapMeasure();
+	clock::time_point start = clock::now();
+
+	for (int i = 1; i < iterations; i++)
+	{
+		load();
+	}
+
+	//Keep the last result alive so the heap it holds on to can be measured
+	auto result = load();
+
+	double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count() / iterations;
+
+	std::cout << name << ": " << ms << " ms per load";
+#ifdef MANIFEST_BENCH
+	std::cout << ", " << (heapCurrent - base) / 1024 << " KB retained, " << (heapPeak - base) / 1024 << " KB peak heap";
+#else
+	(void)base;
+#endif
+	std::cout << std::endl;
+}
+
+bool RunManifestBenchmark(const fs::path& hashes_path)
+{
+	//Read the file up front so both loaders are timed without disk I/O
+	std::ifstream hashes_in(hashes_path, std::ios::in | std::ios::binary);
+	if (!hashes_in.good())
+	{
+		std::cout << "Failed to read " << hashes_path << std::endl;
+		return false;
+	}
+
+	std::stringstream buffer;
+	buffer << hashes_in.rdbuf();
+	const std::string text = buffer.str();
+
+	const int iterations = 20;
+	std::cout << "Loading " << hashes_path << " (" << text.size() / 1024 << " KB), average of " << iterations << " runs" << std::endl;
+
+	Measure("json DOM", iterations, [&]()
+	{
+		return nlohmann::json::parse(text);
+	});
+
+	Measure("Streaming manifest", iterations, [&]()
+	{
+		Manifest manifest;
+		manifest.Load(text.data(), text.size(), ManifestFile::Hashes);
+		return manifest;
+	});
+
+	Manifest manifest;
+	manifest.Load(text.data(), text.size(), ManifestFile::Hashes);
+	std::cout << "Manifest table: " << manifest.PathCount() << " paths, " << manifest.MemoryUsage() / 1024 << " KB" << std::endl;
+
+#ifndef MANIFEST_BENCH
+	std::cout << "Build with MANIFEST_BENCH defined to also measure heap use" << std::endl;
+#endif
+
+	return true;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <experimental/filesystem>
+
+namespace fs = std::experimental::filesystem;
+
+//Times loading a hashes.json into a json DOM against the streaming Manifest loader and reports peak heap use of each
+//Peak heap use is only measured when built with MANIFEST_BENCH defined, see manifest-bench.cpp
+bool RunManifestBenchmark(const fs::path& hashes_path);
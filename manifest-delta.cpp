@@ -0,0 +1,140 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include "manifest-delta.h"
+#include "Include/nlohmann/json.hpp"
+#include <algorithm>
+
+//Delta layout
+//{"from": content hash, "to": content hash, "removed": [paths],
+// "hashes": {hashes.json entries for added and changed paths}, "sizes": {sizes.json entries for the same paths}}
+
+static bool SameEntries(std::span<const ManifestEntry> a, std::span<const ManifestEntry> b)
+{
+	return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const ManifestEntry& x, const ManifestEntry& y)
+	{
+		return x.variant == y.variant && x.digest == y.digest && x.size == y.size;
+	});
+}
+
+//Adds a path to the delta in the same layout as hashes.json and sizes.json
+static void AddDeltaPath(const Manifest& manifest, uint32_t id, nlohmann::json& hashes, nlohmann::json& sizes)
+{
+	std::string path(manifest.Path(id));
+
+	for (const ManifestEntry& entry : manifest.Entries(id))
+	{
+		if (entry.variant == Variant::Any)
+		{
+			hashes[path] = entry.digest.ToHex();
+			if (entry.size != UnknownSize)
+			{
+				sizes[path] = entry.size;
+			}
+			continue;
+		}
+
+		const char* variant = entry.variant == Variant::SDK ? "SDK" : "Default";
+		hashes[path][variant] = entry.digest.ToHex();
+		if (entry.size != UnknownSize)
+		{
+			sizes[path][variant] = entry.size;
+		}
+	}
+}
+
+bool WriteManifestDelta(const Manifest& previous, const Manifest& current, const fs::path& path)
+{
+	nlohmann::json removed = nlohmann::json::array();
+	nlohmann::json hashes = nlohmann::json::object();
+	nlohmann::json sizes = nlohmann::json::object();
+
+	//Both manifests are sorted by path, so walk them together
+	uint32_t p = 0;
+	uint32_t c = 0;
+	while (p < previous.PathCount() || c < current.PathCount())
+	{
+		if (c == current.PathCount() || (p < previous.PathCount() && previous.Path(p) < current.Path(c)))
+		{
+			removed.push_back(std::string(previous.Path(p)));
+			p++;
+		}
+		else if (p == previous.PathCount() || current.Path(c) < previous.Path(p))
+		{
+			AddDeltaPath(current, c, hashes, sizes);
+			c++;
+		}
+		else
+		{
+			if (!SameEntries(previous.Entries(p), current.Entries(c)))
+			{
+				AddDeltaPath(current, c, hashes, sizes);
+			}
+			p++;
+			c++;
+		}
+	}
+
+	nlohmann::json delta;
+	delta["from"] = previous.ContentHash().ToHex();
+	delta["to"] = current.ContentHash().ToHex();
+	delta["removed"] = removed;
+	delta["hashes"] = hashes;
+	delta["sizes"] = sizes;
+
+	std::string text = delta.dump(1);
+	return WriteFileAtomic(path, text.data(), text.size());
+}
+
+DeltaResult ApplyManifestDelta(const Manifest& cached, std::string_view deltaText, Manifest& manifest)
+{
+	nlohmann::json delta = nlohmann::json::parse(deltaText, nullptr, false);
+
+	if (!delta.is_object() || !delta["from"].is_string() || !delta["to"].is_string()
+		|| !delta["removed"].is_array() || !delta["hashes"].is_object() || !delta["sizes"].is_object())
+	{
+		return DeltaResult::NotApplicable;
+	}
+
+	std::string cachedHash = cached.ContentHash().ToHex();
+
+	if (cachedHash == delta["to"])
+	{
+		return DeltaResult::UpToDate;
+	}
+
+	if (cachedHash != delta["from"])
+	{
+		return DeltaResult::NotApplicable;
+	}
+
+	std::vector<std::string> removed;
+	for (auto& path : delta["removed"])
+	{
+		if (!path.is_string())
+		{
+			return DeltaResult::NotApplicable;
+		}
+		removed.push_back(path);
+	}
+	std::sort(removed.begin(), removed.end());
+
+	//The changed paths are few enough to go through the normal loader
+	Manifest changes;
+	std::string hashes = delta["hashes"].dump();
+	std::string sizes = delta["sizes"].dump();
+
+	if (!changes.Load(hashes.data(), hashes.size(), ManifestFile::Hashes)
+		|| !changes.Load(sizes.data(), sizes.size(), ManifestFile::Sizes))
+	{
+		return DeltaResult::NotApplicable;
+	}
+
+	manifest.Merge(cached, changes, removed);
+
+	//Only trust the result if it is exactly the manifest the builder produced
+	if (manifest.ContentHash().ToHex() != delta["to"])
+	{
+		return DeltaResult::NotApplicable;
+	}
+
+	return DeltaResult::Applied;
+}
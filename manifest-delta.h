@@ -0,0 +1,23 @@
+#pragma once
+#include <experimental/filesystem>
+#include <string_view>
+#include "manifest.h"
+
+namespace fs = std::experimental::filesystem;
+
+//hashes.delta.json holds the paths added, changed and removed between two builds
+//It names the content hash of the manifest it applies to and of the manifest it produces
+enum class DeltaResult
+{
+	Applied,
+	//The cached manifest is already the one the delta produces
+	UpToDate,
+	//The delta is for a different manifest or is not valid, the full manifest has to be downloaded
+	NotApplicable
+};
+
+//Written by builder mode next to hashes.json
+bool WriteManifestDelta(const Manifest& previous, const Manifest& current, const fs::path& path);
+
+//Applies deltaText to cached, putting the result in manifest
+DeltaResult ApplyManifestDelta(const Manifest& cached, std::string_view deltaText, Manifest& manifest);
@@ -0,0 +1,136 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include "manifest-shards.h"
+#include "Include/nlohmann/json.hpp"
+#include <fstream>
+#include <memory>
+
+//Index layout
+//{"<shard name>": {"paths": path count, "hash": content hash}, ...}
+
+std::string RootShardName(std::string_view root)
+{
+	while (!root.empty() && (root.front() == '\\' || root.front() == '/'))
+	{
+		root.remove_prefix(1);
+	}
+
+	std::string name(root);
+	for (char& c : name)
+	{
+		if (c == '\\' || c == '/')
+		{
+			c = '_';
+		}
+	}
+	return name;
+}
+
+size_t RootIndex(std::string_view path, std::span<const char* const> roots)
+{
+	for (size_t i = 0; i < roots.size(); i++)
+	{
+		std::string_view prefix(roots[i]);
+		if (path.size() > prefix.size() && path.starts_with(prefix) && path[prefix.size()] == '\\')
+		{
+			return i;
+		}
+	}
+	return roots.size();
+}
+
+std::string ShardName(std::string_view path, std::span<const char* const> roots)
+{
+	size_t root = RootIndex(path, roots);
+	return root == roots.size() ? "base" : RootShardName(roots[root]);
+}
+
+bool WriteManifestShards(const Manifest& manifest, std::span<const char* const> roots, const fs::path& dir)
+{
+	std::vector<std::string> names;
+	for (const char* root : roots)
+	{
+		names.push_back(RootShardName(root));
+	}
+	names.push_back("base");
+
+	std::error_code ec;
+	fs::create_directories(dir, ec);
+
+	nlohmann::json index = nlohmann::json::object();
+
+	for (const std::string& name : names)
+	{
+		Manifest shard;
+		shard.CopyPaths(manifest, [&](std::string_view path) { return ShardName(path, roots) == name; });
+
+		fs::path shard_path = dir;
+		shard_path /= name + ".r5hm";
+
+		if (!shard.WriteBinary(shard_path))
+		{
+			return false;
+		}
+
+		index[name]["paths"] = shard.PathCount();
+		index[name]["hash"] = shard.ContentHash().ToHex();
+	}
+
+	fs::path index_path = dir;
+	index_path /= "hashes.shards.json";
+
+	std::string text = index.dump(1);
+	return WriteFileAtomic(index_path, text.data(), text.size());
+}
+
+//Maps a shard and checks it is the one the index lists
+static bool LoadShard(Manifest& shard, const nlohmann::json& index, const std::string& name, const fs::path& dir)
+{
+	if (!index.contains(name) || !index[name].contains("hash"))
+	{
+		return false;
+	}
+
+	fs::path shard_path = dir;
+	shard_path /= name + ".r5hm";
+
+	return shard.LoadBinary(shard_path) && index[name]["hash"] == shard.ContentHash().ToHex();
+}
+
+bool LoadManifestShards(Manifest& manifest, const std::vector<std::string>& names, const fs::path& dir)
+{
+	fs::path index_path = dir;
+	index_path /= "hashes.shards.json";
+
+	std::ifstream index_in(index_path, std::ios::in);
+	nlohmann::json index = nlohmann::json::parse(index_in, nullptr, false);
+
+	if (!index.is_object() || names.empty())
+	{
+		return false;
+	}
+
+	//A single shard is used in place like hashes.r5hm
+	if (names.size() == 1)
+	{
+		return LoadShard(manifest, index, names[0], dir);
+	}
+
+	//Shards never share a path, so merging them one at a time just interleaves their paths
+	auto merged = std::make_unique<Manifest>();
+	for (const std::string& name : names)
+	{
+		Manifest shard;
+		if (!LoadShard(shard, index, name, dir))
+		{
+			return false;
+		}
+
+		auto next = std::make_unique<Manifest>();
+		next->Merge(*merged, shard, {});
+		merged = std::move(next);
+	}
+
+	manifest.Merge(*merged, Manifest(), {});
+	manifest.BuildPathIndex();
+	return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <experimental/filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "manifest.h"
+
+namespace fs = std::experimental::filesystem;
+
+//The manifest can be split into one shard per root in paths[] so checking part of the install only loads that part
+//Files that are not under any root, like r5apex.exe, go in the "base" shard
+//Shards are written to shards\<name>.r5hm in the hashes.r5hm format and listed in shards\hashes.shards.json
+
+//Name of the shard for a root, e.g. "paks" for \paks and "platform_shaders" for \platform\shaders
+std::string RootShardName(std::string_view root);
+//Index of the root a manifest path is under, or roots.size() for the base shard
+size_t RootIndex(std::string_view path, std::span<const char* const> roots);
+//Name of the shard a manifest path belongs to
+std::string ShardName(std::string_view path, std::span<const char* const> roots);
+
+bool WriteManifestShards(const Manifest& manifest, std::span<const char* const> roots, const fs::path& dir);
+
+//Loads only the named shards, returns false if the index or a shard is missing or a shard does not match the index
+bool LoadManifestShards(Manifest& manifest, const std::vector<std::string>& names, const fs::path& dir);
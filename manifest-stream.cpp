@@ -0,0 +1,325 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include "manifest-stream.h"
+#include "file-util.h"
+#include "curl/curl.h"
+#include <zlib.h>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+
+//Size of the pieces read from disk or decompressed at once
+static const size_t StreamChunkSize = 64 * 1024;
+
+//Hands downloaded chunks from the curl thread to the parser, curl blocks when the parser falls behind
+class ChunkQueue
+{
+public:
+	//Returns false if the consumer has stopped reading
+	bool Push(const char* data, size_t size)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this] { return chunks.size() < Capacity || abandoned; });
+
+		if (abandoned)
+		{
+			return false;
+		}
+
+		chunks.emplace_back(data, size);
+		changed.notify_all();
+		return true;
+	}
+
+	//Returns false once the producer has finished and everything has been read
+	bool Pop(std::string& chunk)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this] { return !chunks.empty() || finished; });
+
+		if (chunks.empty())
+		{
+			return false;
+		}
+
+		chunk = std::move(chunks.front());
+		chunks.pop_front();
+		changed.notify_all();
+		return true;
+	}
+
+	void Finish(bool ok)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		finished = true;
+		succeeded = ok;
+		changed.notify_all();
+	}
+
+	void Abandon()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		abandoned = true;
+		chunks.clear();
+		changed.notify_all();
+	}
+
+	bool Succeeded()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return finished && succeeded;
+	}
+
+private:
+	static const size_t Capacity = 16;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<std::string> chunks;
+	bool finished = false;
+	bool succeeded = false;
+	bool abandoned = false;
+};
+
+//Presents chunks from a source as a std::istream, gunzipping them on the way if needed
+class ChunkStreamBuf : public std::streambuf
+{
+public:
+	ChunkStreamBuf(std::function<bool(std::string&)> next_in, bool gzip_in) : next(std::move(next_in)), gzip(gzip_in)
+	{
+		if (gzip)
+		{
+			//16 + MAX_WBITS accepts the gzip header
+			failed = inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK;
+			output.resize(StreamChunkSize);
+		}
+	}
+
+	~ChunkStreamBuf()
+	{
+		if (gzip)
+		{
+			inflateEnd(&stream);
+		}
+	}
+
+	//True if the compressed data was corrupt or ended early
+	bool Failed() const { return failed; }
+
+protected:
+	int_type underflow() override
+	{
+		if (gptr() < egptr())
+		{
+			return traits_type::to_int_type(*gptr());
+		}
+
+		while (!failed)
+		{
+			if (!gzip)
+			{
+				if (!next(input))
+				{
+					return traits_type::eof();
+				}
+
+				setg(input.data(), input.data(), input.data() + input.size());
+				if (!input.empty())
+				{
+					return traits_type::to_int_type(*gptr());
+				}
+				continue;
+			}
+
+			if (ended)
+			{
+				return traits_type::eof();
+			}
+
+			if (stream.avail_in == 0)
+			{
+				if (!next(input))
+				{
+					//The source ended before the end of the gzip stream
+					failed = true;
+					return traits_type::eof();
+				}
+
+				stream.next_in = (Bytef*)input.data();
+				stream.avail_in = (uInt)input.size();
+			}
+
+			stream.next_out = (Bytef*)output.data();
+			stream.avail_out = (uInt)output.size();
+
+			int ret = inflate(&stream, Z_NO_FLUSH);
+
+			if (ret == Z_STREAM_END)
+			{
+				ended = true;
+			}
+			else if (ret != Z_OK && ret != Z_BUF_ERROR)
+			{
+				failed = true;
+				return traits_type::eof();
+			}
+
+			size_t produced = output.size() - stream.avail_out;
+			if (produced > 0)
+			{
+				setg(output.data(), output.data(), output.data() + produced);
+				return traits_type::to_int_type(*gptr());
+			}
+		}
+
+		return traits_type::eof();
+	}
+
+private:
+	std::function<bool(std::string&)> next;
+	bool gzip;
+	bool failed = false;
+	bool ended = false;
+	z_stream stream = {};
+	std::string input;
+	std::string output;
+};
+
+static bool StreamFromDisk(Manifest& manifest, ManifestFile kind, const fs::path& path, bool gzip)
+{
+	std::ifstream file_in(path, std::ios::in | std::ios::binary);
+
+	if (!file_in.good())
+	{
+		std::cout << "Failed to read " << path.filename() << std::endl;
+		return false;
+	}
+
+	ChunkStreamBuf buf([&file_in](std::string& chunk)
+	{
+		chunk.resize(StreamChunkSize);
+		file_in.read(chunk.data(), chunk.size());
+		chunk.resize((size_t)file_in.gcount());
+		return !chunk.empty();
+	}, gzip);
+
+	std::istream in(&buf);
+	bool parsed = manifest.Load(in, kind) && !buf.Failed();
+
+	if (!parsed)
+	{
+		std::cout << path.filename() << " is not valid, delete it to download a new one" << std::endl;
+	}
+	return parsed;
+}
+
+static size_t QueueWriteCallback(char* pData, size_t size, size_t nmemb, void* puserData)
+{
+	//Returning less than we were given makes curl abort the transfer
+	return ((ChunkQueue*)puserData)->Push(pData, size * nmemb) ? size * nmemb : 0;
+}
+
+static bool StreamFromUrl(Manifest& manifest, ManifestFile kind, const std::string& url, bool gzip)
+{
+	ChunkQueue queue;
+
+	//Download on another thread so downloading, decompressing and parsing all overlap
+	std::thread download([&queue, &url]()
+	{
+		CURL* curl = curl_easy_init();
+
+		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, QueueWriteCallback);
+		curl_easy_setopt(curl, CURLOPT_WRITEDATA, &queue);
+		curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+		curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+
+		CURLcode ret = curl_easy_perform(curl);
+		curl_easy_cleanup(curl);
+
+		queue.Finish(ret == CURLE_OK);
+	});
+
+	ChunkStreamBuf buf([&queue](std::string& chunk) { return queue.Pop(chunk); }, gzip);
+	std::istream in(&buf);
+
+	bool parsed = manifest.Load(in, kind) && !buf.Failed();
+
+	//Stop curl if the parser gave up early
+	queue.Abandon();
+	download.join();
+
+	return parsed && queue.Succeeded();
+}
+
+bool StreamManifestFile(Manifest& manifest, ManifestFile kind, const char* fileName, const char* baseUrl)
+{
+	std::string gzName = std::string(fileName) + ".gz";
+
+	if (fs::exists(fileName))
+	{
+		return StreamFromDisk(manifest, kind, fs::current_path() /= fileName, false);
+	}
+
+	if (fs::exists(gzName))
+	{
+		return StreamFromDisk(manifest, kind, fs::current_path() /= gzName, true);
+	}
+
+	if (StreamFromUrl(manifest, kind, baseUrl + gzName, true))
+	{
+		return true;
+	}
+
+	if (StreamFromUrl(manifest, kind, baseUrl + std::string(fileName), false))
+	{
+		return true;
+	}
+
+	std::cout << "Failed to download " << fileName << std::endl;
+	return false;
+}
+
+bool DownloadText(const std::string& url, std::string& text)
+{
+	CURL* curl = curl_easy_init();
+
+	text.clear();
+	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, StringWriteCallback);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &text);
+	curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+	curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+
+	CURLcode ret = curl_easy_perform(curl);
+	curl_easy_cleanup(curl);
+
+	return ret == CURLE_OK;
+}
+
+bool WriteGzipFile(const fs::path& path, const std::string& text)
+{
+	z_stream stream = {};
+
+	if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		return false;
+	}
+
+	std::string compressed(deflateBound(&stream, (uLong)text.size()), '\0');
+
+	stream.next_in = (Bytef*)text.data();
+	stream.avail_in = (uInt)text.size();
+	stream.next_out = (Bytef*)compressed.data();
+	stream.avail_out = (uInt)compressed.size();
+
+	int ret = deflate(&stream, Z_FINISH);
+	compressed.resize(compressed.size() - stream.avail_out);
+	deflateEnd(&stream);
+
+	return ret == Z_STREAM_END && WriteFileAtomic(path, compressed.data(), compressed.size());
+}
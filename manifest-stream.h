@@ -0,0 +1,17 @@
+#pragma once
+#include <experimental/filesystem>
+#include <string>
+#include "manifest.h"
+
+namespace fs = std::experimental::filesystem;
+
+//Streams a hashes.json/sizes.json into manifest without ever holding the whole text in memory
+//Uses fileName from the current directory, then fileName.gz, and otherwise downloads fileName.gz or fileName from baseUrl
+//Downloads are decompressed and parsed as the data arrives
+bool StreamManifestFile(Manifest& manifest, ManifestFile kind, const char* fileName, const char* baseUrl);
+
+//Downloads a small file whole, returns false if the request fails
+bool DownloadText(const std::string& url, std::string& text);
+
+//Writes text gzip compressed, used by builder mode to publish the compressed manifests
+bool WriteGzipFile(const fs::path& path, const std::string& text);
@@ -0,0 +1,125 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include "manifest-writer.h"
+#include <algorithm>
+
+void SortBuiltFiles(std::vector<BuiltFile>& files)
+{
+	std::stable_sort(files.begin(), files.end(), [](const BuiltFile& a, const BuiltFile& b)
+	{
+		return std::tie(a.path, a.variant) < std::tie(b.path, b.variant);
+	});
+
+	//Keep the last of each path and variant
+	auto last = std::unique(files.rbegin(), files.rend(), [](const BuiltFile& a, const BuiltFile& b)
+	{
+		return a.path == b.path && a.variant == b.variant;
+	});
+	files.erase(files.begin(), last.base());
+}
+
+//Escapes a string the same way json dump does
+static void AppendString(std::string& out, std::string_view text)
+{
+	static const char digits[] = "0123456789abcdef";
+
+	out += '"';
+	for (char c : text)
+	{
+		switch (c)
+		{
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\b': out += "\\b"; break;
+		case '\f': out += "\\f"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if ((unsigned char)c < 0x20)
+			{
+				out += "\\u00";
+				out += digits[(unsigned char)c >> 4];
+				out += digits[(unsigned char)c & 0xf];
+			}
+			else
+			{
+				out += c;
+			}
+		}
+	}
+	out += '"';
+}
+
+static void AppendValue(std::string& out, const BuiltFile& file, ManifestFile kind)
+{
+	if (kind == ManifestFile::Hashes)
+	{
+		out += '"';
+		out += file.digest.ToHex();
+		out += '"';
+	}
+	else
+	{
+		out += std::to_string(file.size);
+	}
+}
+
+void WriteManifestText(const std::vector<BuiltFile>& files, ManifestFile kind, std::string& out)
+{
+	if (files.empty())
+	{
+		out += "{}";
+		return;
+	}
+
+	//Around 70 bytes of hashes.json per file, sizes.json is smaller
+	out.reserve(out.size() + files.size() * (files.front().path.size() + 56));
+	out += "{\n";
+
+	for (size_t i = 0; i < files.size();)
+	{
+		//Sorting puts the SDK version of a file right before its Default version
+		const BuiltFile* sdk = files[i].variant == Variant::SDK ? &files[i] : nullptr;
+		const BuiltFile* def = nullptr;
+
+		if (sdk == nullptr)
+		{
+			def = &files[i++];
+		}
+		else
+		{
+			i++;
+			if (i < files.size() && files[i].path == sdk->path && files[i].variant == Variant::Default)
+			{
+				def = &files[i++];
+			}
+		}
+
+		out += ' ';
+		AppendString(out, (sdk ? sdk : def)->path);
+		out += ": ";
+
+		if (sdk == nullptr)
+		{
+			AppendValue(out, *def, kind);
+		}
+		else
+		{
+			//Object keys are written in sorted order, so Default comes before SDK
+			out += "{\n";
+			if (def != nullptr)
+			{
+				out += "  \"Default\": ";
+				AppendValue(out, *def, kind);
+				out += ",\n";
+			}
+			out += "  \"SDK\": ";
+			AppendValue(out, *sdk, kind);
+			out += "\n }";
+		}
+
+		out += i < files.size() ? ",\n" : "\n";
+	}
+
+	out += "}";
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "digest.h"
+#include "manifest.h"
+
+//A file hashed by builder mode
+//Files hashed from the SDK folder are SDK, everything else is Default until written, where a Default file without an SDK version is written as a plain value
+struct BuiltFile
+{
+	std::string path;
+	Variant variant;
+	Digest digest;
+	uint64_t size;
+};
+
+//Sorts by path then variant so the output does not depend on the order files were hashed in
+//If a file was hashed twice the last result is kept
+void SortBuiltFiles(std::vector<BuiltFile>& files);
+
+//Appends hashes.json or sizes.json text for sorted files to out, byte for byte what json dump(1) writes for the same table
+void WriteManifestText(const std::vector<BuiltFile>& files, ManifestFile kind, std::string& out);
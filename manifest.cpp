@@ -0,0 +1,781 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include "manifest.h"
+#include "Include/nlohmann/json.hpp"
+#include "Sha1.h"
+#include <algorithm>
+#include <numeric>
+
+//hashes.r5hm layout, all values are little endian
+//Header
+//ManifestEntry[entryCount] sorted by path id then variant
+//uint32_t firstEntry[pathCount + 1]
+//uint32_t seeds[indexBuckets], uint32_t slots[pathCount] for the perfect hash path index
+//Path table, each path sorted by name and stored as
+//	uint16_t length shared with the previous path, uint16_t suffix length, suffix bytes
+struct BinaryHeader
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t flags;
+	uint32_t pathCount;
+	uint32_t entryCount;
+	uint32_t pathTableSize;
+	uint32_t indexBuckets;
+	//FNV-1a of everything after the header
+	uint64_t checksum;
+};
+
+static_assert(sizeof(BinaryHeader) == 32, "hashes.r5hm header layout changed");
+static_assert(sizeof(ManifestEntry) == 40, "hashes.r5hm entry layout changed");
+
+static const char binaryMagic[4] = { 'R', '5', 'H', 'M' };
+static const uint16_t binaryVersion = 3;
+//Set in flags if the entries have sizes from sizes.json
+static const uint16_t BinaryHasSizes = 1;
+
+//The path is hashed once, the bucket comes from the high bits and the slot from remixing it with the bucket seed
+static uint64_t PathHash(std::string_view path)
+{
+	return Fnv1a((const unsigned char*)path.data(), path.size());
+}
+
+static uint32_t PathBucket(uint64_t hash, uint32_t buckets)
+{
+	return (uint32_t)((hash >> 32) % buckets);
+}
+
+static uint32_t PathSlot(uint64_t hash, uint32_t seed, uint32_t slots)
+{
+	//splitmix64 finalizer
+	uint64_t x = hash ^ ((uint64_t)seed * 0x9e3779b97f4a7c15ull);
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	x = x ^ (x >> 31);
+	return (uint32_t)(x % slots);
+}
+
+//Streams a hashes.json/sizes.json file into a Manifest without building a json DOM
+class ManifestSax : public nlohmann::json_sax<nlohmann::json>
+{
+public:
+	ManifestSax(Manifest& manifest_in, ManifestFile kind_in) : manifest(manifest_in), kind(kind_in) {}
+
+	bool null() override { return false; }
+	bool boolean(bool) override { return false; }
+	bool number_integer(number_integer_t) override { return false; }
+	bool number_float(number_float_t, const string_t&) override { return false; }
+	bool binary(binary_t&) override { return false; }
+	bool start_array(std::size_t) override { return false; }
+	bool end_array() override { return false; }
+
+	bool number_unsigned(number_unsigned_t value) override
+	{
+		return kind == ManifestFile::Sizes && depth > 0 && manifest.AddSize(path, variant, value);
+	}
+
+	bool string(string_t& value) override
+	{
+		return kind == ManifestFile::Hashes && depth > 0 && manifest.AddHash(path, variant, value);
+	}
+
+	bool start_object(std::size_t) override
+	{
+		//Only the root object and one level of {"SDK": ..., "Default": ...} objects are allowed
+		return ++depth <= 2;
+	}
+
+	bool end_object() override
+	{
+		depth--;
+		return true;
+	}
+
+	bool key(string_t& value) override
+	{
+		if (depth == 1)
+		{
+			//The parser does not need the key again so take its buffer instead of copying it
+			path = std::move(value);
+			variant = Variant::Any;
+			return true;
+		}
+
+		if (value == "SDK")
+		{
+			variant = Variant::SDK;
+			return true;
+		}
+
+		if (value == "Default")
+		{
+			variant = Variant::Default;
+			return true;
+		}
+
+		return false;
+	}
+
+	bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) override
+	{
+		return false;
+	}
+
+private:
+	Manifest& manifest;
+	ManifestFile kind;
+	int depth = 0;
+	std::string path;
+	Variant variant = Variant::Any;
+};
+
+bool Manifest::Load(std::istream& in, ManifestFile kind)
+{
+	if (kind == ManifestFile::Hashes)
+	{
+		Clear();
+
+		//Size the table from the file length if the stream can tell us
+		//Streams that can't seek, like a download, just grow as they go
+		std::streampos start = in.tellg();
+		if (start != std::streampos(-1))
+		{
+			if (in.seekg(0, std::ios::end))
+			{
+				Reserve((size_t)(in.tellg() - start));
+			}
+			in.clear();
+			in.seekg(start);
+		}
+		in.clear();
+	}
+
+	ManifestSax sax(*this, kind);
+	bool ok = nlohmann::json::sax_parse(in, &sax);
+
+	if (kind == ManifestFile::Hashes)
+	{
+		Finalize();
+	}
+	else if (ok && entries == ownedEntries.data())
+	{
+		hasSizes = true;
+	}
+
+	return ok;
+}
+
+bool Manifest::Load(const char* text, size_t length, ManifestFile kind)
+{
+	if (kind == ManifestFile::Hashes)
+	{
+		Clear();
+		Reserve(length);
+	}
+
+	ManifestSax sax(*this, kind);
+	bool ok = nlohmann::json::sax_parse(text, text + length, &sax);
+
+	if (kind == ManifestFile::Hashes)
+	{
+		Finalize();
+	}
+	else if (ok && entries == ownedEntries.data())
+	{
+		hasSizes = true;
+	}
+
+	return ok;
+}
+
+bool Manifest::LoadBinary(const fs::path& path)
+{
+	Clear();
+
+	if (!mapped.Open(path))
+	{
+		return false;
+	}
+
+	const unsigned char* data = mapped.Data();
+	const BinaryHeader* header = (const BinaryHeader*)data;
+	size_t entriesSize = 0;
+	size_t firstEntrySize = 0;
+
+	//An index over no paths would have no slots to hash into
+	bool valid = mapped.Size() >= sizeof(BinaryHeader)
+		&& memcmp(header->magic, binaryMagic, sizeof(binaryMagic)) == 0
+		&& header->version == binaryVersion
+		&& (header->indexBuckets == 0 || header->pathCount != 0);
+
+	size_t indexSize = 0;
+
+	if (valid)
+	{
+		entriesSize = (size_t)header->entryCount * sizeof(ManifestEntry);
+		firstEntrySize = ((size_t)header->pathCount + 1) * sizeof(uint32_t);
+		indexSize = header->indexBuckets == 0 ? 0 : ((size_t)header->indexBuckets + header->pathCount) * sizeof(uint32_t);
+
+		valid = mapped.Size() == sizeof(BinaryHeader) + entriesSize + firstEntrySize + indexSize + header->pathTableSize
+			&& header->checksum == Fnv1a(data + sizeof(BinaryHeader), mapped.Size() - sizeof(BinaryHeader));
+	}
+
+	if (!valid)
+	{
+		Clear();
+		return false;
+	}
+
+	entries = (const ManifestEntry*)(data + sizeof(BinaryHeader));
+	entryCount = header->entryCount;
+	hasSizes = (header->flags & BinaryHasSizes) != 0;
+	firstEntry = (const uint32_t*)(data + sizeof(BinaryHeader) + entriesSize);
+
+	if (header->indexBuckets != 0)
+	{
+		indexSeeds = firstEntry + header->pathCount + 1;
+		indexSlots = indexSeeds + header->indexBuckets;
+		indexBuckets = header->indexBuckets;
+
+		for (uint32_t slot = 0; slot < header->pathCount; slot++)
+		{
+			if (indexSlots[slot] >= header->pathCount)
+			{
+				Clear();
+				return false;
+			}
+		}
+	}
+
+	//Expand the prefix compressed paths so they can be handed out as string_views
+	const unsigned char* pos = data + sizeof(BinaryHeader) + entriesSize + firstEntrySize + indexSize;
+	const unsigned char* end = pos + header->pathTableSize;
+
+	pathData.reserve(header->pathTableSize * 2);
+	pathSpans.reserve(header->pathCount);
+
+	for (uint32_t id = 0; id < header->pathCount; id++)
+	{
+		uint16_t shared;
+		uint16_t suffix;
+
+		if (end - pos < 4)
+		{
+			Clear();
+			return false;
+		}
+		memcpy(&shared, pos, sizeof(shared));
+		memcpy(&suffix, pos + 2, sizeof(suffix));
+		pos += 4;
+
+		if (end - pos < suffix || (id == 0 ? shared != 0 : shared > pathSpans.back().second))
+		{
+			Clear();
+			return false;
+		}
+
+		uint32_t start = (uint32_t)pathData.size();
+		if (shared > 0)
+		{
+			pathData.append(pathData, pathSpans.back().first, shared);
+		}
+		pathData.append((const char*)pos, suffix);
+		pos += suffix;
+
+		pathSpans.push_back({ start, (uint32_t)shared + suffix });
+	}
+
+	//Every entry has to refer to a real path and firstEntry has to cover exactly the entries
+	if (firstEntry[0] != 0 || firstEntry[header->pathCount] != entryCount)
+	{
+		Clear();
+		return false;
+	}
+	for (uint32_t id = 0; id < header->pathCount; id++)
+	{
+		if (firstEntry[id] > firstEntry[id + 1])
+		{
+			Clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Manifest::WriteBinary(const fs::path& path)
+{
+	if (!HasPathIndex())
+	{
+		BuildPathIndex();
+	}
+
+	std::string pathTable;
+	std::string_view previous;
+
+	for (uint32_t id = 0; id < PathCount(); id++)
+	{
+		std::string_view current = Path(id);
+
+		size_t shared = 0;
+		while (shared < previous.size() && shared < current.size() && shared < 0xffff && previous[shared] == current[shared])
+		{
+			shared++;
+		}
+
+		if (current.size() - shared > 0xffff)
+		{
+			return false;
+		}
+
+		uint16_t lengths[2] = { (uint16_t)shared, (uint16_t)(current.size() - shared) };
+		pathTable.append((const char*)lengths, sizeof(lengths));
+		pathTable.append(current.substr(shared));
+
+		previous = current;
+	}
+
+	size_t entriesSize = (size_t)entryCount * sizeof(ManifestEntry);
+	size_t firstEntrySize = ((size_t)PathCount() + 1) * sizeof(uint32_t);
+	size_t seedsSize = (size_t)indexBuckets * sizeof(uint32_t);
+	size_t slotsSize = indexBuckets == 0 ? 0 : (size_t)PathCount() * sizeof(uint32_t);
+	std::vector<unsigned char> file(sizeof(BinaryHeader) + entriesSize + firstEntrySize + seedsSize + slotsSize + pathTable.size());
+
+	BinaryHeader* header = (BinaryHeader*)file.data();
+	memcpy(header->magic, binaryMagic, sizeof(binaryMagic));
+	header->version = binaryVersion;
+	header->flags = hasSizes ? BinaryHasSizes : 0;
+	header->pathCount = PathCount();
+	header->entryCount = entryCount;
+	header->pathTableSize = (uint32_t)pathTable.size();
+	header->indexBuckets = indexBuckets;
+
+	unsigned char* pos = file.data() + sizeof(BinaryHeader);
+	if (entryCount > 0)
+	{
+		memcpy(pos, entries, entriesSize);
+	}
+	pos += entriesSize;
+	memcpy(pos, firstEntry, firstEntrySize);
+	pos += firstEntrySize;
+	if (indexBuckets != 0)
+	{
+		memcpy(pos, indexSeeds, seedsSize);
+		pos += seedsSize;
+		memcpy(pos, indexSlots, slotsSize);
+		pos += slotsSize;
+	}
+	memcpy(pos, pathTable.data(), pathTable.size());
+
+	header->checksum = Fnv1a(file.data() + sizeof(BinaryHeader), file.size() - sizeof(BinaryHeader));
+
+	return WriteFileAtomic(path, file.data(), file.size());
+}
+
+bool Manifest::FindPath(std::string_view path, uint32_t& id) const
+{
+	if (indexBuckets != 0)
+	{
+		uint64_t hash = PathHash(path);
+		id = indexSlots[PathSlot(hash, indexSeeds[PathBucket(hash, indexBuckets)], PathCount())];
+		return Path(id) == path;
+	}
+
+	id = LowerBound(path);
+	return id < PathCount() && Path(id) == path;
+}
+
+void Manifest::BuildPathIndex()
+{
+	const uint32_t count = PathCount();
+
+	ownedSeeds.clear();
+	ownedSlots.clear();
+	indexSeeds = nullptr;
+	indexSlots = nullptr;
+	indexBuckets = 0;
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	std::vector<uint64_t> hashes(count);
+	for (uint32_t id = 0; id < count; id++)
+	{
+		hashes[id] = PathHash(Path(id));
+	}
+
+	//Around 4 paths per bucket keeps the index small and the seed search short, more buckets are used if a seed cannot be found
+	for (uint32_t buckets = count / 4 + 1; ; buckets *= 2)
+	{
+		std::vector<std::vector<uint32_t>> bucketPaths(buckets);
+		for (uint32_t id = 0; id < count; id++)
+		{
+			bucketPaths[PathBucket(hashes[id], buckets)].push_back(id);
+		}
+
+		//Place the fullest buckets first while there are still plenty of free slots
+		std::vector<uint32_t> order(buckets);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return bucketPaths[a].size() > bucketPaths[b].size(); });
+
+		std::vector<uint32_t> seeds(buckets, 0);
+		std::vector<uint32_t> slots(count, ~0u);
+		std::vector<uint32_t> placed;
+		bool ok = true;
+
+		for (uint32_t bucket : order)
+		{
+			if (bucketPaths[bucket].empty())
+			{
+				break;
+			}
+
+			bool found = false;
+			for (uint32_t seed = 0; seed < 1u << 20 && !found; seed++)
+			{
+				placed.clear();
+				found = true;
+
+				for (uint32_t id : bucketPaths[bucket])
+				{
+					uint32_t slot = PathSlot(hashes[id], seed, count);
+					if (slots[slot] != ~0u)
+					{
+						found = false;
+						break;
+					}
+					slots[slot] = id;
+					placed.push_back(slot);
+				}
+
+				if (found)
+				{
+					seeds[bucket] = seed;
+				}
+				else
+				{
+					for (uint32_t slot : placed)
+					{
+						slots[slot] = ~0u;
+					}
+				}
+			}
+
+			if (!found)
+			{
+				ok = false;
+				break;
+			}
+		}
+
+		if (ok)
+		{
+			ownedSeeds = std::move(seeds);
+			ownedSlots = std::move(slots);
+			indexSeeds = ownedSeeds.data();
+			indexSlots = ownedSlots.data();
+			indexBuckets = buckets;
+			return;
+		}
+	}
+}
+
+uint32_t Manifest::LowerBound(std::string_view path) const
+{
+	uint32_t low = 0;
+	uint32_t high = PathCount();
+
+	while (low < high)
+	{
+		uint32_t mid = low + (high - low) / 2;
+		if (Path(mid) < path)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+const ManifestEntry* Manifest::Select(uint32_t pathId, bool bHasSDK) const
+{
+	const ManifestEntry* sdk = nullptr;
+	const ManifestEntry* def = nullptr;
+
+	for (uint32_t i = firstEntry[pathId]; i < firstEntry[pathId + 1]; i++)
+	{
+		switch (entries[i].variant)
+		{
+		case Variant::Any:
+			//This file should exist no matter if user has the sdk
+			return &entries[i];
+		case Variant::SDK:
+			sdk = &entries[i];
+			break;
+		case Variant::Default:
+			def = &entries[i];
+			break;
+		}
+	}
+
+	//If we have no default value this file only exists in the sdk and we should skip it if the sdk is not installed
+	return bHasSDK ? sdk : def;
+}
+
+Digest Manifest::ContentHash() const
+{
+	CSha1* sha = new CSha1();
+	Sha1_Init(sha);
+
+	for (uint32_t id = 0; id < PathCount(); id++)
+	{
+		std::string_view path = Path(id);
+		Sha1_Update(sha, (const unsigned char*)path.data(), path.size());
+		Sha1_Update(sha, (const unsigned char*)"", 1);
+
+		for (const ManifestEntry& entry : Entries(id))
+		{
+			unsigned char variant = (unsigned char)entry.variant;
+			Sha1_Update(sha, &variant, 1);
+			Sha1_Update(sha, entry.digest.bytes, sizeof(entry.digest.bytes));
+			Sha1_Update(sha, (const unsigned char*)&entry.size, sizeof(entry.size));
+		}
+	}
+
+	Digest hash;
+	Sha1_Final(sha, hash.bytes);
+	delete sha;
+	return hash;
+}
+
+void Manifest::Merge(const Manifest& base, const Manifest& changes, const std::vector<std::string>& removed)
+{
+	Clear();
+	//An empty side has no entries that could be missing sizes, like the manifest shards are merged into
+	hasSizes = (base.hasSizes || base.entryCount == 0) && (changes.hasSizes || changes.entryCount == 0);
+	pathData.reserve(base.pathData.size() + changes.pathData.size());
+	pathSpans.reserve(base.PathCount() + changes.PathCount());
+	ownedEntries.reserve(base.entryCount + changes.entryCount);
+
+	//Both sides are sorted by path, so walk them together
+	uint32_t b = 0;
+	uint32_t c = 0;
+	while (b < base.PathCount() || c < changes.PathCount())
+	{
+		std::string_view basePath = b < base.PathCount() ? base.Path(b) : std::string_view();
+		bool takeChange = c < changes.PathCount() && (b == base.PathCount() || changes.Path(c) <= basePath);
+
+		if (takeChange)
+		{
+			//A changed path replaces the base entries for it
+			if (b < base.PathCount() && changes.Path(c) == basePath)
+			{
+				b++;
+			}
+			AppendPath(changes.Path(c), changes.Entries(c));
+			c++;
+		}
+		else
+		{
+			if (!std::binary_search(removed.begin(), removed.end(), basePath))
+			{
+				AppendPath(basePath, base.Entries(b));
+			}
+			b++;
+		}
+	}
+
+	Finalize();
+}
+
+void Manifest::CopyPaths(const Manifest& source, const std::function<bool(std::string_view)>& keep)
+{
+	Clear();
+	hasSizes = source.hasSizes;
+
+	for (uint32_t id = 0; id < source.PathCount(); id++)
+	{
+		if (keep(source.Path(id)))
+		{
+			AppendPath(source.Path(id), source.Entries(id));
+		}
+	}
+
+	Finalize();
+}
+
+size_t Manifest::MemoryUsage() const
+{
+	//Mapped entries are not counted since they live in the page cache
+	return pathData.capacity()
+		+ pathSpans.capacity() * sizeof(pathSpans[0])
+		+ ownedEntries.capacity() * sizeof(ownedEntries[0])
+		+ ownedFirstEntry.capacity() * sizeof(ownedFirstEntry[0])
+		+ (ownedSeeds.capacity() + ownedSlots.capacity()) * sizeof(uint32_t);
+}
+
+void Manifest::Reserve(size_t jsonLength)
+{
+	//A hashes.json line is around 100 bytes, about half of which is the path
+	pathData.reserve(jsonLength / 2);
+	pathSpans.reserve(jsonLength / 96);
+	ownedEntries.reserve(jsonLength / 96);
+}
+
+void Manifest::Clear()
+{
+	pathData.clear();
+	pathSpans.clear();
+	ownedEntries.clear();
+	ownedFirstEntry.assign(1, 0);
+	ownedSeeds.clear();
+	ownedSlots.clear();
+	mapped.Close();
+
+	indexSeeds = nullptr;
+	indexSlots = nullptr;
+	indexBuckets = 0;
+
+	entries = ownedEntries.data();
+	entryCount = 0;
+	firstEntry = ownedFirstEntry.data();
+	hasSizes = false;
+}
+
+void Manifest::AppendPath(std::string_view path, std::span<const ManifestEntry> pathEntries)
+{
+	pathSpans.push_back({ (uint32_t)pathData.size(), (uint32_t)path.size() });
+	pathData += path;
+
+	for (ManifestEntry entry : pathEntries)
+	{
+		entry.pathId = PathCount() - 1;
+		ownedEntries.push_back(entry);
+	}
+}
+
+bool Manifest::AddHash(std::string_view path, Variant variant, std::string_view hash)
+{
+	//Variants of the same file arrive one after another, only store the path once
+	if (pathSpans.empty() || Path(PathCount() - 1) != path)
+	{
+		pathSpans.push_back({ (uint32_t)pathData.size(), (uint32_t)path.size() });
+		pathData += path;
+	}
+
+	ManifestEntry entry;
+	entry.pathId = PathCount() - 1;
+	entry.variant = variant;
+
+	if (!Digest::FromHex(hash, entry.digest))
+	{
+		return false;
+	}
+
+	ownedEntries.push_back(entry);
+	return true;
+}
+
+bool Manifest::AddSize(std::string_view path, Variant variant, uint64_t size)
+{
+	uint32_t id;
+
+	//Sizes for files that are not in hashes.json are ignored
+	if (!FindPath(path, id))
+	{
+		return true;
+	}
+
+	//Entries mapped from hashes.r5hm already have their sizes and cannot be changed
+	if (ownedEntries.empty())
+	{
+		return true;
+	}
+
+	for (uint32_t i = firstEntry[id]; i < firstEntry[id + 1]; i++)
+	{
+		if (ownedEntries[i].variant == variant)
+		{
+			ownedEntries[i].size = size;
+		}
+	}
+	return true;
+}
+
+void Manifest::Finalize()
+{
+	//hashes.json is written sorted, so normally there is nothing to do
+	bool sorted = true;
+	for (uint32_t id = 1; id < PathCount() && sorted; id++)
+	{
+		sorted = Path(id - 1) < Path(id);
+	}
+
+	if (!sorted)
+	{
+		SortPaths();
+	}
+
+	//Entries only need sorting by variant within each path
+	std::stable_sort(ownedEntries.begin(), ownedEntries.end(), [](const ManifestEntry& a, const ManifestEntry& b)
+	{
+		return std::tie(a.pathId, a.variant) < std::tie(b.pathId, b.variant);
+	});
+
+	ownedFirstEntry.assign(pathSpans.size() + 1, 0);
+	for (const ManifestEntry& entry : ownedEntries)
+	{
+		ownedFirstEntry[entry.pathId + 1]++;
+	}
+	for (size_t i = 1; i < ownedFirstEntry.size(); i++)
+	{
+		ownedFirstEntry[i] += ownedFirstEntry[i - 1];
+	}
+
+	//The table is not added to after loading so give back anything that was over reserved
+	pathData.shrink_to_fit();
+	pathSpans.shrink_to_fit();
+	ownedEntries.shrink_to_fit();
+
+	entries = ownedEntries.data();
+	entryCount = (uint32_t)ownedEntries.size();
+	firstEntry = ownedFirstEntry.data();
+}
+
+void Manifest::SortPaths()
+{
+	std::vector<uint32_t> order(pathSpans.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return Path(a) < Path(b); });
+
+	std::string sortedData;
+	sortedData.reserve(pathData.size());
+	std::vector<std::pair<uint32_t, uint32_t>> sortedSpans;
+	sortedSpans.reserve(pathSpans.size());
+	std::vector<uint32_t> remap(pathSpans.size());
+
+	for (uint32_t oldId : order)
+	{
+		std::string_view path = Path(oldId);
+
+		//Duplicate keys share one path id
+		if (sortedSpans.empty() || std::string_view(sortedData).substr(sortedSpans.back().first, sortedSpans.back().second) != path)
+		{
+			sortedSpans.push_back({ (uint32_t)sortedData.size(), (uint32_t)path.size() });
+			sortedData += path;
+		}
+		remap[oldId] = (uint32_t)sortedSpans.size() - 1;
+	}
+
+	pathData = std::move(sortedData);
+	pathSpans = std::move(sortedSpans);
+
+	for (ManifestEntry& entry : ownedEntries)
+	{
+		entry.pathId = remap[entry.pathId];
+	}
+}
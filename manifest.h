@@ -0,0 +1,136 @@
+#pragma once
+#include <experimental/filesystem>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "digest.h"
+#include "file-util.h"
+
+namespace fs = std::experimental::filesystem;
+
+//Which install an entry applies to
+//Files that differ between installs are stored as {"SDK": ..., "Default": ...} in hashes.json
+enum class Variant : uint8_t
+{
+	Any,
+	SDK,
+	Default
+};
+
+//Files laid out the same way as hashes.json
+enum class ManifestFile
+{
+	Hashes,
+	Sizes
+};
+
+const uint64_t UnknownSize = ~0ull;
+
+//Also the record layout of hashes.r5hm, so padding is explicit
+struct ManifestEntry
+{
+	uint32_t pathId = 0;
+	Variant variant = Variant::Any;
+	uint8_t reserved[3] = {};
+	Digest digest;
+	uint32_t reserved2 = 0;
+	uint64_t size = UnknownSize;
+};
+
+//Flat, sorted table of the known good files
+//Paths are sorted and identified by their index, entries are sorted by path id then variant
+class Manifest
+{
+public:
+	//Streams hashes.json into the table, replacing anything loaded before
+	//Loading sizes.json afterwards fills in the size of the matching entries
+	bool Load(std::istream& in, ManifestFile kind);
+	bool Load(const char* text, size_t length, ManifestFile kind);
+
+	//Maps a hashes.r5hm written by WriteBinary, the entries are used in place without parsing
+	//Returns false if the file is missing or corrupt
+	bool LoadBinary(const fs::path& path);
+	//Builds the path index first if there is not one yet
+	bool WriteBinary(const fs::path& path);
+
+	uint32_t PathCount() const { return (uint32_t)pathSpans.size(); }
+	std::string_view Path(uint32_t id) const { return std::string_view(pathData).substr(pathSpans[id].first, pathSpans[id].second); }
+
+	//Returns false if path is not in the manifest
+	//Uses the perfect hash index when there is one, otherwise a binary search
+	bool FindPath(std::string_view path, uint32_t& id) const;
+
+	//Builds a minimal perfect hash over the paths so FindPath needs one hash and one compare
+	//WriteBinary stores it in hashes.r5hm so the checker does not have to build it
+	void BuildPathIndex();
+	bool HasPathIndex() const { return indexBuckets != 0; }
+
+	//True once sizes.json has been loaded, entries without a size in it keep UnknownSize
+	bool HasSizes() const { return hasSizes; }
+
+	//Returns the id of the first path that is not less than path, or PathCount() if there is none
+	uint32_t LowerBound(std::string_view path) const;
+
+	std::span<const ManifestEntry> Entries() const { return std::span<const ManifestEntry>(entries, entryCount); }
+	std::span<const ManifestEntry> Entries(uint32_t pathId) const { return std::span<const ManifestEntry>(entries + firstEntry[pathId], entries + firstEntry[pathId + 1]); }
+
+	//Returns the entry for a path that applies to this install
+	//Returns nullptr if the file is not expected to exist, e.g. an SDK only file when the SDK is not installed
+	const ManifestEntry* Select(uint32_t pathId, bool bHasSDK) const;
+
+	//Sha1 of every path and entry in order, identifies the content no matter which file it was loaded from
+	Digest ContentHash() const;
+
+	//Replaces the table with the paths of base that are not in removed or changes, plus everything in changes
+	//removed must be sorted, base and changes must not be this manifest
+	void Merge(const Manifest& base, const Manifest& changes, const std::vector<std::string>& removed);
+
+	//Replaces the table with the paths of source that keep returns true for
+	void CopyPaths(const Manifest& source, const std::function<bool(std::string_view)>& keep);
+
+	//Bytes held by the table, used to compare against the json DOM
+	size_t MemoryUsage() const;
+
+private:
+	friend class ManifestSax;
+
+	void Clear();
+	//Adds a path after the last one with a copy of its entries, used to build a table from other tables
+	void AppendPath(std::string_view path, std::span<const ManifestEntry> pathEntries);
+	//Reserves space for a hashes.json of the given length so the table does not reallocate while parsing
+	void Reserve(size_t jsonLength);
+	//Called by the parser for every value in the file
+	bool AddHash(std::string_view path, Variant variant, std::string_view hash);
+	bool AddSize(std::string_view path, Variant variant, uint64_t size);
+	//Sorts the paths and entries once a hashes.json has been parsed
+	void Finalize();
+	//Sorts the paths and renumbers the entries, only needed if hashes.json was not written in order
+	void SortPaths();
+
+	//All paths back to back, pathSpans holds the offset and length of each
+	std::string pathData;
+	std::vector<std::pair<uint32_t, uint32_t>> pathSpans;
+
+	//Entries for path id i are entries[firstEntry[i]] to entries[firstEntry[i + 1]]
+	//These point into the owned vectors when loaded from json, or into the mapped file when loaded from hashes.r5hm
+	const ManifestEntry* entries = nullptr;
+	uint32_t entryCount = 0;
+	const uint32_t* firstEntry = nullptr;
+
+	//Perfect hash index, a path hashes to a bucket whose seed places it in a slot holding its path id
+	const uint32_t* indexSeeds = nullptr;
+	const uint32_t* indexSlots = nullptr;
+	uint32_t indexBuckets = 0;
+
+	bool hasSizes = false;
+
+	std::vector<ManifestEntry> ownedEntries;
+	std::vector<uint32_t> ownedFirstEntry;
+	std::vector<uint32_t> ownedSeeds;
+	std::vector<uint32_t> ownedSlots;
+	MappedFile mapped;
+};
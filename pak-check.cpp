@@ -0,0 +1,144 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include "pak-check.h"
+#include <cstdint>
+#include <cstring>
+
+//Version 8 .rpak header, all values are little endian
+//Everything after the header is compressed if flags has RPakCompressed set, in order:
+//Patch header, patch file sizes and patch numbers if patchCount is not 0
+//Starpak paths then optional starpak paths, each null terminated
+//Segment, page, pointer, asset, guid and relation tables
+struct RPakHeader
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t flags;
+	uint64_t fileTime;
+	uint64_t checksum;
+	//Size of the file on disk, including this header
+	uint64_t compressedSize;
+	uint64_t embeddedStarpakOffset;
+	uint64_t unknown0;
+	uint64_t decompressedSize;
+	uint64_t embeddedStarpakSize;
+	uint64_t unknown1;
+	uint16_t starpakPathsSize;
+	uint16_t optStarpakPathsSize;
+	uint16_t segmentCount;
+	uint16_t pageCount;
+	uint16_t patchCount;
+	uint16_t alignment;
+	uint32_t pointerCount;
+	uint32_t assetCount;
+	uint32_t guidCount;
+	uint32_t relationCount;
+	uint8_t unknown2[16];
+	uint32_t pageOffset;
+	uint8_t unknown3[8];
+};
+
+static_assert(sizeof(RPakHeader) == 0x80, "rpak header layout changed");
+
+static const uint32_t rpakMagic = 0x6b615052;
+static const uint32_t starpakMagic = 0x6b505253;
+static const uint16_t RPakCompressed = 0x100;
+
+//Sizes of the tables following the starpak paths
+static const uint64_t patchHeaderSize = 8;
+static const uint64_t patchFileSize = 16;
+static const uint64_t segmentSize = 16;
+static const uint64_t pageSize = 12;
+static const uint64_t pointerSize = 8;
+static const uint64_t assetSize = 72;
+static const uint64_t guidSize = 8;
+static const uint64_t relationSize = 4;
+
+bool CheckRPak(const MappedFile& pak, const std::function<bool(std::string_view)>& hasStarpak, std::string& problem)
+{
+	if (pak.Size() < sizeof(RPakHeader))
+	{
+		problem = "file is smaller than an rpak header";
+		return false;
+	}
+
+	RPakHeader header;
+	memcpy(&header, pak.Data(), sizeof(header));
+
+	if (header.magic != rpakMagic)
+	{
+		problem = "not an rpak";
+		return false;
+	}
+
+	if (header.version != 8)
+	{
+		return true;
+	}
+
+	uint64_t expectedSize = header.compressedSize + header.embeddedStarpakSize;
+	if (pak.Size() != header.compressedSize && pak.Size() != expectedSize)
+	{
+		problem = "file is " + std::to_string(pak.Size()) + " bytes but its header says " + std::to_string(header.compressedSize);
+		return false;
+	}
+
+	bool compressed = (header.flags & RPakCompressed) != 0;
+	if (compressed ? header.decompressedSize < sizeof(RPakHeader) : header.decompressedSize != header.compressedSize)
+	{
+		problem = "decompressed size " + std::to_string(header.decompressedSize) + " does not fit a file of " + std::to_string(header.compressedSize) + " bytes";
+		return false;
+	}
+
+	uint64_t patchSize = header.patchCount == 0 ? 0 : patchHeaderSize + header.patchCount * (patchFileSize + sizeof(uint16_t));
+
+	uint64_t tablesSize = sizeof(RPakHeader) + patchSize + header.starpakPathsSize + header.optStarpakPathsSize
+		+ header.segmentCount * segmentSize + header.pageCount * pageSize + header.pointerCount * pointerSize
+		+ header.assetCount * assetSize + header.guidCount * guidSize + header.relationCount * relationSize;
+
+	if (tablesSize > header.decompressedSize)
+	{
+		problem = "its tables need " + std::to_string(tablesSize) + " bytes but it only has " + std::to_string(header.decompressedSize);
+		return false;
+	}
+
+	//The starpak paths can only be read without decompressing the pak
+	if (compressed || header.starpakPathsSize == 0)
+	{
+		return true;
+	}
+
+	const char* paths = (const char*)pak.Data() + sizeof(RPakHeader) + patchSize;
+	if (paths[header.starpakPathsSize - 1] != '\0')
+	{
+		problem = "starpak paths are not terminated";
+		return false;
+	}
+
+	//Optional starpaks are allowed to be missing so only the required ones are looked up
+	for (const char* path = paths; path < paths + header.starpakPathsSize; path += strlen(path) + 1)
+	{
+		if (*path != '\0' && !hasStarpak(path))
+		{
+			problem = std::string("streams from ") + path + " which is not in the install";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool CheckStarPak(const MappedFile& pak, std::string& problem)
+{
+	uint32_t magic = 0;
+	if (pak.Size() >= sizeof(magic))
+	{
+		memcpy(&magic, pak.Data(), sizeof(magic));
+	}
+
+	if (magic != starpakMagic)
+	{
+		problem = "not a starpak";
+		return false;
+	}
+	return true;
+}
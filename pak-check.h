@@ -0,0 +1,13 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <string_view>
+#include "file-util.h"
+
+//Checks the header of a version 8 .rpak against the file's real length, returns false and sets problem if it is broken
+//The starpaks an uncompressed pak streams from are passed to hasStarpak like paks\Win64\common.starpak
+//Other versions are not checked and return true
+bool CheckRPak(const MappedFile& pak, const std::function<bool(std::string_view)>& hasStarpak, std::string& problem);
+
+//Checks the header of a .starpak, returns false and sets problem if it is broken
+bool CheckStarPak(const MappedFile& pak, std::string& problem);
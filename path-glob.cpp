@@ -0,0 +1,77 @@
+#include "path-glob.h"
+#include <cctype>
+
+static bool SameChar(char a, char b)
+{
+	if (a == '/')
+	{
+		a = '\\';
+	}
+	if (b == '/')
+	{
+		b = '\\';
+	}
+	return std::tolower((unsigned char)a) == std::tolower((unsigned char)b);
+}
+
+static bool MatchFrom(std::string_view pattern, std::string_view text)
+{
+	while (!pattern.empty())
+	{
+		if (pattern.starts_with("**"))
+		{
+			pattern.remove_prefix(2);
+			for (size_t i = 0; i <= text.size(); i++)
+			{
+				if (MatchFrom(pattern, text.substr(i)))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		if (pattern.front() == '*')
+		{
+			pattern.remove_prefix(1);
+			for (size_t i = 0; i <= text.size(); i++)
+			{
+				if (MatchFrom(pattern, text.substr(i)))
+				{
+					return true;
+				}
+
+				//A single * stays within one directory
+				if (i < text.size() && text[i] == '\\')
+				{
+					return false;
+				}
+			}
+			return false;
+		}
+
+		if (text.empty() || (pattern.front() == '?' ? text.front() == '\\' : !SameChar(pattern.front(), text.front())))
+		{
+			return false;
+		}
+
+		pattern.remove_prefix(1);
+		text.remove_prefix(1);
+	}
+
+	return text.empty();
+}
+
+bool GlobMatch(std::string_view pattern, std::string_view path)
+{
+	if (pattern.find_first_of("\\/") == std::string_view::npos)
+	{
+		size_t slash = path.find_last_of('\\');
+		if (slash != std::string_view::npos)
+		{
+			path.remove_prefix(slash + 1);
+		}
+	}
+
+	return MatchFrom(pattern, path);
+}
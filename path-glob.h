@@ -0,0 +1,7 @@
+#pragma once
+#include <string_view>
+
+//Matches a path from the install folder like \paks\Win64\common.rpak against a pattern, ignoring case
+//* and ? do not match \, ** matches anything
+//Patterns without a \ are matched against the file name only
+bool GlobMatch(std::string_view pattern, std::string_view path);
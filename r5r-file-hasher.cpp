@@ -7,26 +7,121 @@
 #include <format>
 #include <fstream>
 #include "Sha1.h"
-#include "curl/curl.h"
+#include "hash-cache.h"
+#include "hash-results.h"
+#include "chunk-manifest.h"
+#include "chunk-repair.h"
+#include "content-index.h"
+#include "dir-watcher.h"
+#include "file-util.h"
+#include "manifest.h"
+#include "manifest-bench.h"
+#include "manifest-delta.h"
+#include "manifest-shards.h"
+#include "manifest-stream.h"
+#include "manifest-writer.h"
+#include "pak-check.h"
+#include "path-glob.h"
+#include "vpk.h"
+#include "vpk-manifest.h"
+#include "worker-pool.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <thread>
 
 namespace fs = std::experimental::filesystem;
 
-//Known is the hashes from hashes.json or from github
-nlohmann::json known;
-//Unknown is a users hashed files
-nlohmann::json unknown;
+//Manifest is the known good hashes and sizes from hashes.json/sizes.json or from github
+Manifest manifest;
+//Results are the users hashed files
+HashResults results;
+//Files that failed the last check and why, keyed by path
+std::map<std::string, std::string> badFiles;
+
+//Files hashed in builder mode, written out as hashes.json and sizes.json
+std::vector<BuiltFile> builtFiles;
+
+//Per chunk hashes from chunks.r5hc, or the ones being generated in builder mode with --chunks
+ChunkManifest chunkManifest;
+//chunks.r5hc from the last build, chunks of files that have not changed since are copied from it
+ChunkManifest previousChunks;
+bool hasChunks = false;
+//Byte ranges of damaged files that differ from chunks.r5hc, keyed by path
+std::map<std::string, std::vector<ByteRange>> damagedRanges;
+//Sha1 of every packed file in the VPK archives, built with --vpk in builder mode and read from vpkentries.r5hv when checking
+VpkManifest vpkManifest;
+bool hasVpkManifest = false;
 
 bool shouldAddSDK = false;
 
-//Vars used for downloading the json from github into a buffer
-char* hashesJson = nullptr;
-double hashFileSize = 0;
-size_t bytesWritten = 0;
+//Files are hashed on several threads, resultsMutex guards results, badFiles, builtFiles and the console while they are
+std::mutex resultsMutex;
+std::mutex cacheMutex;
+//Set to stop hashing early, files being read stop at the next buffer
+std::atomic<bool> cancelHashing = false;
+
+//Command line options
+//Only check that every file exists and has the right size, files with the wrong size are then hashed
+bool metadataOnly = false;
+//Read and write the hash cache, disabled with --no-cache
+bool useCache = true;
+//Ignore cached hashes but still update the cache with the new ones
+bool rehash = false;
+//Keep running after the first check and recheck files as they change
+bool watchMode = false;
+//Also check the hashes against both the SDK and Default versions of the install and report which one it matches
+bool checkProfiles = false;
+//Stop at the first missing or damaged file, skip the pause and return a failing exit code
+bool failFast = false;
+//Paths or patterns given with --only or read from an --only-list file, empty checks everything
+std::vector<std::string> onlyPatterns;
+//Rules given with --priority, checked before priority_rules
+std::vector<std::string> priorityRules;
+//Folder or url to fetch damaged and missing files from, set with --repair
+std::string repairSource;
+//Also write per chunk hashes to chunks.r5hc in builder mode
+bool buildChunks = false;
+//Threads used to hash files, set with --threads, 0 uses one per core
+unsigned threadCount = 0;
+//Shards of the install to check, set with --root, empty checks everything
+std::vector<std::string> onlyRoots;
+//Compare the streaming manifest loader against parsing hashes.json into a json DOM, then exit
+bool benchManifest = false;
+//Check VPK archives by the crc of each packed file in their _dir.vpk instead of hashing them whole
+//In builder mode also write the sha1 of every packed file to vpkentries.r5hv
+bool vpkEntries = false;
+//Also hash files that are not in the manifest instead of only listing them
+bool hashExtras = false;
+//Report files with the same content after the check, set with --duplicates or --duplicates-with
+bool findDuplicates = false;
+//Other installs whose hashcache.bin is searched for duplicates too
+std::vector<std::string> duplicateInstalls;
+//Packed files to check with --packed, only those are read from their archives
+std::vector<std::string> packedPatterns;
+//Path ids of the VPK archives checked by their packed files instead of being hashed
+std::set<uint32_t> vpkCheckedArchives;
+
+//Files hashed during this run by volume and file index, so hard links are only read once, filled with --duplicates
+std::map<std::pair<uint64_t, uint64_t>, std::pair<FileIdentity, std::string>> linkedHashes;
+//Every file hashed during this run by content, filled with --duplicates
+ContentIndex contentIndex;
+
+//Hashes from previous runs, keyed by file identity
+HashCache hashCache;
 
 //Config options for hash json generation
 //Paths to check, will check all files and directories from this point
 const char* paths[]{ "\\paks", "\\vpk", "\\media" , "\\audio", "\\stbsp", "\\cfg" , "\\bin", "\\materials", "\\platform\\shaders", "\\platform\\resource", "\\platform\\scripts"};
-const char* excluded_files[]{ "r5r-file-hasher.exe", "build.txt", "gameinfo.txt", "gameversion.txt", "hashes.json", "launcher.exe"};
+//Which entries of paths[] were given with --root, the last is the base directory
+bool selectedRoots[std::size(paths) + 1] = {};
+const char* excluded_files[]{ "r5r-file-hasher.exe", "build.txt", "gameinfo.txt", "gameversion.txt", "hashes.json", "sizes.json", "hashes.json.gz", "sizes.json.gz", "hashes.r5hm", "chunks.r5hc", "hashes.delta.json", "manifestcache.r5hm", "hashcache.bin", "verifystatus.json", "vpkentries.r5hv", "launcher.exe"};
+//Files are hashed and reported in the order of the first rule they match, files that match none go last
+//Patterns are described in path-glob.h
+const char* priority_rules[]{ "\\r5apex.exe", "\\*.dll", "\\bin\\**.dll", "*.rpak", "*.starpak", "*.vpk" };
 
 const char* logo = R"(+-----------------------------------------------+
 |   ___ ___ ___     _              _        _   |
@@ -36,237 +131,1907 @@ const char* logo = R"(+-----------------------------------------------+
 |                                               |
 +-----------------------------------------------+)";
 const int ReadSize = 1048576;
+const char* githubUrl = "https://raw.githubusercontent.com/O-Robotic/r5r-file-hasher/master/";
 
-size_t curlWriteCallback(char* pData, size_t size, size_t nmemb, void* puserData)
+//Waits for a key before the console closes, skipped with --fail-fast so the launcher is never left waiting
+void Pause()
 {
-	
-	if (hashesJson == nullptr)
+	if (!failFast)
+	{
+		system("pause");
+	}
+}
+
+//Streams a manifest file from the current directory into manifest, or downloads it from github if it does not exist
+bool LoadManifest(const char* fileName, ManifestFile kind)
+{
+	if (StreamManifestFile(manifest, kind, fileName, githubUrl))
+	{
+		return true;
+	}
+
+	std::cout << "\n" << fileName << " could not be loaded, make sure you put this exe in the folder with r5apex or place " << fileName << " next to it" << std::endl;
+	return false;
+}
+
+//Applies hashes.delta.json from github to the manifest downloaded by a previous run
+//Returns false if there is no cached manifest or the delta does not apply to it
+bool UpdateCachedManifest(const fs::path& cache_path)
+{
+	DeltaResult result;
+
+	{
+		Manifest cached;
+		if (!cached.LoadBinary(cache_path))
+		{
+			return false;
+		}
+
+		std::string delta_text;
+		if (!DownloadText(std::string(githubUrl) + "hashes.delta.json", delta_text))
+		{
+			return false;
+		}
+
+		result = ApplyManifestDelta(cached, delta_text, manifest);
+	}
+
+	if (result == DeltaResult::UpToDate)
+	{
+		return manifest.LoadBinary(cache_path);
+	}
+
+	if (result == DeltaResult::Applied)
+	{
+		std::cout << "Updated the cached manifest with hashes.delta.json" << std::endl;
+
+		//The cached copy is unmapped by now so it can be replaced
+		if (!manifest.WriteBinary(cache_path))
+		{
+			std::cout << "Failed to save manifestcache.r5hm" << std::endl;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+bool RootSelected(const std::string& name)
+{
+	return onlyRoots.empty() || std::find(onlyRoots.begin(), onlyRoots.end(), name) != onlyRoots.end();
+}
+
+//Patterns also select everything under a folder they name, so \paks works as well as \paks\**
+void AddOnlyPattern(const std::string& pattern)
+{
+	onlyPatterns.push_back(pattern);
+	onlyPatterns.push_back(pattern + "\\**");
+}
+
+bool OnlyMatch(std::string_view path)
+{
+	for (const std::string& pattern : onlyPatterns)
+	{
+		if (GlobMatch(pattern, path))
+		{
+			return true;
+		}
+	}
+	return onlyPatterns.empty();
+}
+
+//True if path is in one of the roots being checked and matches --only
+bool PathSelected(std::string_view path)
+{
+	return (onlyRoots.empty() || selectedRoots[RootIndex(path, paths)]) && OnlyMatch(path);
+}
+
+//Adds every line of an --only-list file to onlyPatterns
+bool ReadOnlyList(const char* fileName)
+{
+	std::ifstream list_in(fileName, std::ios::in);
+	if (!list_in.good())
+	{
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(list_in, line))
+	{
+		//Trim whitespace and \r from lists written on windows
+		size_t start = line.find_first_not_of(" \t\r");
+		size_t end = line.find_last_not_of(" \t\r");
+		if (start != std::string::npos)
+		{
+			AddOnlyPattern(line.substr(start, end - start + 1));
+		}
+	}
+	return true;
+}
+
+//Loads the known good hashes, and sizes if needed, preferring hashes.r5hm over hashes.json and sizes.json
+bool LoadKnownGood(bool needSizes)
+{
+	//Checking part of the install only needs the shards for those roots
+	if (!onlyRoots.empty() && fs::exists("shards\\hashes.shards.json"))
+	{
+		if (LoadManifestShards(manifest, onlyRoots, fs::current_path() /= "shards") && (!needSizes || manifest.HasSizes()))
+		{
+			return true;
+		}
+
+		std::cout << "The manifest shards are not valid or have no sizes, loading the whole manifest instead" << std::endl;
+	}
+
+	if (fs::exists("hashes.r5hm"))
+	{
+		if (manifest.LoadBinary(fs::current_path() /= "hashes.r5hm") && (!needSizes || manifest.HasSizes()))
+		{
+			return true;
+		}
+
+		std::cout << "hashes.r5hm is not valid or has no sizes, using hashes.json instead" << std::endl;
+	}
+
+	//Manifests put in the folder by hand are used as they are
+	if (fs::exists("hashes.json") || fs::exists("hashes.json.gz"))
+	{
+		return LoadManifest("hashes.json", ManifestFile::Hashes) && (!needSizes || LoadManifest("sizes.json", ManifestFile::Sizes));
+	}
+
+	//Otherwise bring the manifest downloaded last time up to date, and only download the whole thing if that fails
+	//A cached copy saved without sizes is downloaded again when they are needed
+	fs::path cache_path = fs::current_path() /= "manifestcache.r5hm";
+
+	if (UpdateCachedManifest(cache_path) && (!needSizes || manifest.HasSizes()))
+	{
+		return true;
+	}
+
+	if (!LoadManifest("hashes.json", ManifestFile::Hashes))
+	{
+		return false;
+	}
+
+	//Sizes are only required for --metadata, without them every entry keeps UnknownSize
+	if (needSizes)
+	{
+		if (!LoadManifest("sizes.json", ManifestFile::Sizes))
+		{
+			return false;
+		}
+	}
+	else if (!StreamManifestFile(manifest, ManifestFile::Sizes, "sizes.json", githubUrl))
+	{
+		std::cout << "sizes.json could not be loaded, continuing without sizes" << std::endl;
+	}
+
+	if (!manifest.WriteBinary(cache_path))
+	{
+		std::cout << "Failed to save manifestcache.r5hm" << std::endl;
+	}
+	return true;
+}
+
+//Reads a file and sets file_hash to its sha1 as a hex string, returns false if the file could not be opened
+//If chunks is given it is also filled with the sha1 of every HashChunkSize bytes from the same reads
+bool Sha1File(const fs::path& path_in, std::string& file_hash, std::vector<Digest>* chunks = nullptr)
+{
+
+	CSha1* sha = new CSha1();
+	Sha1_Init(sha);
+
+	CSha1* chunkSha = nullptr;
+	size_t chunkFill = 0;
+	if (chunks)
+	{
+		chunks->clear();
+		chunkSha = new CSha1();
+		Sha1_Init(chunkSha);
+	}
+
+	unsigned char* buf = (unsigned char*)malloc(ReadSize);
+
+	if (!buf)
+	{
+		std::cout << "Failed to allocate needed memory" << std::endl;
+		Pause();
+		exit(EXIT_FAILURE);
+	}
+
+	FILE* file = fopen(path_in.u8string().c_str(), "rb");
+
+	size_t filePos = 0;
+
+	bool didHash = false;
+
+	if (file)
+	{
+		while (filePos = fread(buf, 1, ReadSize, file))
+		{
+			Sha1_Update(sha, buf, filePos);
+
+			//Reads can end partway through a chunk, so the chunk boundaries are tracked separately
+			for (size_t offset = 0; chunkSha && offset < filePos;)
+			{
+				size_t take = std::min(filePos - offset, (size_t)HashChunkSize - chunkFill);
+				Sha1_Update(chunkSha, buf + offset, take);
+				offset += take;
+				chunkFill += take;
+
+				if (chunkFill == HashChunkSize)
+				{
+					chunks->emplace_back();
+					Sha1_Final(chunkSha, chunks->back().bytes);
+					Sha1_Init(chunkSha);
+					chunkFill = 0;
+				}
+			}
+
+			if (cancelHashing)
+			{
+				break;
+			}
+		}
+		didHash = !cancelHashing;
+		fclose(file);
+	}
+	else
+	{
+		std::cout << "Failed to open: " << path_in.u8string().c_str() << std::endl;
+	}
+
+	unsigned char result[20];
+	Sha1_Final(sha, result);
+
+	if (chunkSha && chunkFill > 0)
+	{
+		chunks->emplace_back();
+		Sha1_Final(chunkSha, chunks->back().bytes);
+	}
+	delete chunkSha;
+
+	std::stringstream shastr;
+	shastr << std::hex << std::setfill('0');
+	for (const auto& byte : result)
+	{
+		shastr << std::setw(2) << (int)byte;
+	}
+
+	free(buf);
+	delete sha;
+
+	file_hash = shastr.str();
+
+	return didHash;
+}
+
+//Main hashing function
+void RecordHash(const std::string& path_str, const std::string& file_hash)
+{
+	Digest digest;
+	if (Digest::FromHex(file_hash, digest))
+	{
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		results.Add(manifest, path_str, digest);
+	}
+}
+
+//Adds the files in dir that should be hashed to files, skipping excluded files
+void CollectFiles(const fs::path& dir, bool recursive, std::vector<fs::path>& files)
+{
+	auto add = [&files](const fs::path& file)
+	{
+		if (std::find(std::begin(excluded_files), std::end(excluded_files), file.filename().u8string()) != std::end(excluded_files))
+		{
+			return;
+		}
+
+		if (file.has_filename() && file.has_extension())
+		{
+			files.push_back(file);
+		}
+	};
+
+	if (recursive)
+	{
+		for (auto& file : fs::recursive_directory_iterator(dir))
+		{
+			add(file.path());
+		}
+	}
+	else
+	{
+		for (auto& file : fs::directory_iterator(dir))
+		{
+			add(file.path());
+		}
+	}
+}
+
+//Files in lower tiers are hashed first
+size_t PriorityTier(std::string_view path)
+{
+	for (size_t i = 0; i < priorityRules.size(); i++)
+	{
+		if (GlobMatch(priorityRules[i], path))
+		{
+			return i;
+		}
+	}
+
+	for (size_t i = 0; i < std::size(priority_rules); i++)
+	{
+		if (GlobMatch(priority_rules[i], path))
+		{
+			return priorityRules.size() + i;
+		}
+	}
+
+	return priorityRules.size() + std::size(priority_rules);
+}
+
+//Reorders files by priority tier, keeping the directory order within a tier
+void SortByPriority(std::vector<fs::path>& files)
+{
+	std::string root = fs::current_path().u8string();
+
+	std::vector<std::pair<size_t, fs::path>> tiered;
+	tiered.reserve(files.size());
+	for (fs::path& file : files)
+	{
+		std::string path_str = file.u8string();
+		tiered.push_back({ PriorityTier(std::string_view(path_str).substr(root.size())), std::move(file) });
+	}
+
+	std::stable_sort(tiered.begin(), tiered.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		files[i] = std::move(tiered[i].second);
+	}
+}
+
+//Path of a file relative to the install like \paks\Win64\common.rpak, as used in hashes.json
+std::string InstallPath(const fs::path& path_in)
+{
+	std::string path_str = path_in.u8string();
+	std::size_t ind = path_str.find(fs::current_path().u8string());
+	if (shouldAddSDK)
+	{
+		path_str.erase(ind, (fs::current_path() += "\\SDK").u8string().length());
+	}
+	else
+	{
+		path_str.erase(ind, fs::current_path().u8string().length());
+	}
+	return path_str;
+}
+
+//Sets path_str to the path of a file relative to the install and file_hash to its sha1, from the hash cache if it has not changed
+//If chunks is given it is filled with the chunk hashes while the file is read, and left empty if the hash came from the cache
+//Safe to call from several threads, returns false if the file could not be read
+bool ComputeHash(const fs::path& path_in, std::string& path_str, std::string& file_hash, std::vector<Digest>* chunks = nullptr)
+{
+	path_str = InstallPath(path_in);
+
+	if (chunks)
+	{
+		chunks->clear();
+	}
+
+	//Files that have not changed since the last run reuse the cached hash instead of being read again
+	FileIdentity identity;
+	bool identified = GetFileIdentity(path_in, identity);
+	bool cacheable = useCache && identified;
+	bool cached = false;
+
+	if (cacheable && !rehash)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		cached = hashCache.Lookup(identity, file_hash);
+	}
+
+	//With --duplicates, hard links to a file already hashed in this run reuse its hash even without the cache
+	if (!cached && identified && findDuplicates)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		auto linked = linkedHashes.find({ identity.device, identity.inode });
+		if (linked != linkedHashes.end() && linked->second.first == identity)
+		{
+			file_hash = linked->second.second;
+			cached = true;
+		}
+	}
+
+	if (!cached)
+	{
+		if (!Sha1File(path_in, file_hash, chunks))
+		{
+			return false;
+		}
+
+		//Only keep the result if the file did not change while it was being hashed
+		FileIdentity after;
+		if (identified && GetFileIdentity(path_in, after) && after == identity)
+		{
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			if (findDuplicates)
+			{
+				linkedHashes[{ identity.device, identity.inode }] = { identity, file_hash };
+			}
+
+			if (cacheable)
+			{
+				hashCache.Store(identity, path_str, file_hash);
+			}
+		}
+	}
+
+	Digest digest;
+	if (findDuplicates && identified && Digest::FromHex(file_hash, digest))
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		contentIndex.Add(path_str, identity, digest);
+	}
+
+	return true;
+}
+
+//Adds the sha1 of every file packed in a VPK archive to vpkManifest, used by builder mode with --vpk
+void AddVpkEntries(const fs::path& path_in, const std::string& path_str)
+{
+	fs::path dir_path;
+	uint16_t archive;
+	VpkDirectory directory;
+	MappedFile mapped;
+
+	if (!FindVpkDirectory(path_in, dir_path, archive) || !directory.Load(dir_path) || !mapped.Open(path_in))
+	{
+		return;
+	}
+
+	for (const VpkEntry& entry : directory.Entries())
+	{
+		Digest digest;
+		if (entry.archive == archive && HashVpkEntry(entry, mapped, digest))
+		{
+			std::lock_guard<std::mutex> lock(resultsMutex);
+			vpkManifest.Add(path_str, entry.path, digest);
+		}
+	}
+}
+
+#ifdef BUILDER
+//Copies the chunks of a file from the last build's chunks.r5hc, returns false if it has none for a file of this size
+bool PreviousChunks(const std::string& path_str, Variant variant, uint64_t size, std::vector<Digest>& chunks)
+{
+	uint64_t previous_size;
+	std::span<const Digest> previous;
+
+	//Default files without an SDK version are stored as Any
+	if (!previousChunks.Find(path_str, variant, previous_size, previous)
+		&& !(variant == Variant::Default && previousChunks.Find(path_str, Variant::Any, previous_size, previous)))
+	{
+		return false;
+	}
+
+	if (previous_size != size)
+	{
+		return false;
+	}
+
+	chunks.assign(previous.begin(), previous.end());
+	return true;
+}
+#endif
+
+//Returns false if the file could not be read
+bool HashFile(const fs::path& path_in, const bool gen_hash)
+{
+	std::string path_str;
+	std::string file_hash;
+	std::vector<Digest> chunks;
+
+	//With --chunks the chunk hashes come from the same read as the file hash
+	if (!ComputeHash(path_in, path_str, file_hash, gen_hash && buildChunks ? &chunks : nullptr))
+	{
+		return false;
+	}
+
+#ifdef BUILDER
+	if (!gen_hash)
+	{
+		RecordHash(path_str, file_hash);
+	}
+	else
+	{
+		//Files found in the SDK folder are the SDK version, the same file in the base install is then the Default version
+		BuiltFile built{ path_str, shouldAddSDK ? Variant::SDK : Variant::Default, Digest(), fs::file_size(path_in) };
+		Digest::FromHex(file_hash, built.digest);
+
+		//Files whose hash came from the cache have not changed, so their chunks are taken from the last chunks.r5hc
+		//They are only read again if it does not have them
+		uint64_t chunked_size = built.size;
+		bool chunked = buildChunks;
+		if (chunked && chunks.empty() && built.size > 0 && !PreviousChunks(path_str, built.variant, built.size, chunks))
+		{
+			chunked = HashChunks(path_in, chunks, chunked_size);
+		}
+
+		//Packed files are only recorded from the base install, the checker does not use them for SDK versions of an archive
+		if (vpkEntries && !shouldAddSDK)
+		{
+			AddVpkEntries(path_in, path_str);
+		}
+
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		if (chunked)
+		{
+			chunkManifest.Add(path_str, built.variant, chunked_size, std::move(chunks));
+		}
+		builtFiles.push_back(std::move(built));
+
+		std::cout << "Hashed: " << path_str << "\nHash: " << file_hash << "\n" << std::endl;
+	}
+#endif
+
+#ifndef BUILDER
+	RecordHash(path_str, file_hash);
+#endif
+	return true;
+}
+
+
+//Checks the hashed file for a manifest path, returns nullptr if the file is fine or is not expected to exist
+const char* CheckEntry(uint32_t pathId, bool bHasSDK)
+{
+	const ManifestEntry* expected = manifest.Select(pathId, bHasSDK);
+	if (expected == nullptr)
+	{
+		return nullptr;
+	}
+
+	const Digest* found = results.Find(pathId);
+	if (found == nullptr)
+	{
+		return "File missing";
+	}
+
+	if (!(*found == expected->digest))
+	{
+		return "Invalid File found";
+	}
+
+	return nullptr;
+}
+
+//Checks that every file in sizes.json exists and has the expected size without reading any file data
+//Files with the wrong size are hashed and checked against hashes.json, returns true if bad files were found
+bool VerifyMetadata(bool bHasSDK)
+{
+	bool bad_files = false;
+	std::vector<uint32_t> wrong_size;
+	uint32_t checked = 0;
+
+	for (uint32_t id = 0; id < manifest.PathCount(); id++)
+	{
+		const ManifestEntry* expected = manifest.Select(id, bHasSDK);
+		if (expected == nullptr || !PathSelected(manifest.Path(id)))
+		{
+			continue;
+		}
+		checked++;
+
+		std::error_code ec;
+		std::uintmax_t size = fs::file_size(fs::current_path() += manifest.Path(id), ec);
+
+		if (ec)
+		{
+			bad_files = true;
+			std::cout << "File missing: " << manifest.Path(id) << std::endl;
+
+			if (failFast)
+			{
+				return true;
+			}
+			continue;
+		}
+
+		//Files missing from sizes.json can only be checked by hashing them
+		if (expected->size == UnknownSize)
+		{
+			wrong_size.push_back(id);
+		}
+		else if (size != expected->size)
+		{
+			std::cout << "Size mismatch: " << manifest.Path(id) << " (" << size << " bytes, expected " << expected->size << ")" << std::endl;
+			wrong_size.push_back(id);
+		}
+	}
+
+	//Only hash the files that failed the size check
+	//With --fail-fast each one is checked straight away so the first bad one stops the rest
+	for (uint32_t id : wrong_size)
+	{
+		HashFile(fs::current_path() += manifest.Path(id), false);
+
+		if (failFast)
+		{
+			results.Sort();
+			if (const char* problem = CheckEntry(id, bHasSDK))
+			{
+				std::cout << problem << ": " << manifest.Path(id) << std::endl;
+				return true;
+			}
+		}
+	}
+	results.Sort();
+
+	for (uint32_t id : wrong_size)
+	{
+		std::string key(manifest.Path(id));
+
+		if (const char* problem = CheckEntry(id, bHasSDK))
+		{
+			bad_files = true;
+			std::cout << problem << ": " << key << std::endl;
+
+			if (failFast)
+			{
+				return true;
+			}
+		}
+		else if (manifest.Select(id, bHasSDK)->size != UnknownSize)
+		{
+			//The hash matches so sizes.json is out of date for this file
+			std::cout << "Hash matches despite size mismatch, sizes.json may be out of date: " << key << std::endl;
+		}
+	}
+
+	std::cout << "\nChecked " << checked << " file sizes, hashed " << wrong_size.size() << " files" << std::endl;
+
+	return bad_files;
+}
+
+//Rehashes a damaged file chunk by chunk and reports which byte ranges differ from chunks.r5hc
+void ReportDamagedRanges(const fs::path& file, const std::string& path_str, Variant variant)
+{
+	uint64_t expected_size;
+	std::span<const Digest> expected;
+
+	if (!chunkManifest.Find(path_str, variant, expected_size, expected))
+	{
+		return;
+	}
+
+	std::vector<Digest> actual;
+	uint64_t actual_size;
+
+	if (!HashChunks(file, actual, actual_size))
+	{
+		return;
+	}
+
+	std::vector<ByteRange> ranges = DamagedRanges(expected, expected_size, actual, actual_size);
+
+	std::lock_guard<std::mutex> lock(resultsMutex);
+
+	if (ranges.empty())
+	{
+		std::cout << "No chunks of " << path_str << " differ, chunks.r5hc may be out of date" << std::endl;
+		return;
+	}
+
+	uint64_t damaged = 0;
+	for (const ByteRange& range : ranges)
+	{
+		damaged += range.second - range.first;
+	}
+
+	std::cout << "Damaged ranges of " << path_str << " (" << damaged << " of " << expected_size << " bytes):" << std::endl;
+	for (const ByteRange& range : ranges)
+	{
+		std::cout << "  bytes " << range.first << " to " << range.second << std::endl;
+	}
+
+	damagedRanges[path_str] = std::move(ranges);
+}
+
+//Checks a packed file by its crc, compressed packed files are checked by their sha1 in vpkentries.r5hv instead if it lists them
+//useDigests is false for SDK versions of an archive since vpkentries.r5hv is built from the base install
+VpkCheck CheckPackedFile(std::string_view archive, const VpkEntry& entry, const MappedFile& mapped, bool useDigests)
+{
+	Digest expected;
+	if (!entry.Compressed() || !useDigests || !hasVpkManifest || !vpkManifest.Find(archive, entry.path, expected))
+	{
+		return CheckVpkEntry(entry, mapped);
+	}
+
+	Digest actual;
+	return HashVpkEntry(entry, mapped, actual) && actual == expected ? VpkCheck::Ok : VpkCheck::Damaged;
+}
+
+//Prints which packed files of a damaged VPK archive do not match their crc or vpkentries.r5hv
+//Compressed packed files that can not be checked either way are reported if they overlap a damaged range from chunks.r5hc
+void ReportDamagedEntries(const fs::path& file, const std::string& path_str, Variant variant)
+{
+	fs::path dir_path;
+	uint16_t archive;
+	VpkDirectory directory;
+	MappedFile mapped;
+
+	if (!FindVpkDirectory(file, dir_path, archive) || !directory.Load(dir_path) || !mapped.Open(file))
+	{
+		return;
+	}
+
+	std::vector<ByteRange> ranges;
+	{
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		auto found = damagedRanges.find(path_str);
+		if (found != damagedRanges.end())
+		{
+			ranges = found->second;
+		}
+	}
+
+	std::vector<const VpkEntry*> damaged;
+	size_t packed = 0;
+	size_t unchecked = 0;
+
+	for (const VpkEntry& entry : directory.Entries())
+	{
+		if (entry.archive != archive)
+		{
+			continue;
+		}
+		packed++;
+
+		VpkCheck check = CheckPackedFile(path_str, entry, mapped, variant != Variant::SDK);
+		if (check == VpkCheck::Unchecked)
+		{
+			bool overlaps = std::any_of(ranges.begin(), ranges.end(), [&](const ByteRange& range) { return VpkEntryOverlaps(entry, range.first, range.second); });
+			if (overlaps)
+			{
+				check = VpkCheck::Damaged;
+			}
+			else if (ranges.empty())
+			{
+				unchecked++;
+			}
+		}
+
+		if (check == VpkCheck::Damaged)
+		{
+			damaged.push_back(&entry);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(resultsMutex);
+
+	std::cout << damaged.size() << " of " << packed << " packed files in " << path_str << " are damaged" << std::endl;
+	for (const VpkEntry* entry : damaged)
+	{
+		std::cout << "  " << entry->path << std::endl;
+	}
+
+	if (unchecked != 0)
+	{
+		std::cout << unchecked << " compressed packed files could not be checked without chunks.r5hc or vpkentries.r5hv" << std::endl;
+	}
+}
+
+//Loads the _dir.vpk at dir_path if it matches hashes.json, returns nullptr otherwise
+//Directories are kept in directories so each is only checked once
+const VpkDirectory* LoadCheckedDirectory(const fs::path& dir_path, bool bHasSDK, std::map<std::string, std::unique_ptr<VpkDirectory>>& directories)
+{
+	std::string key = dir_path.u8string();
+	auto found = directories.find(key);
+	if (found != directories.end())
+	{
+		return found->second.get();
+	}
+
+	std::unique_ptr<VpkDirectory>& directory = directories[key];
+
+	std::string path_str;
+	std::string file_hash;
+	Digest digest;
+	uint32_t id;
+
+	if (!ComputeHash(dir_path, path_str, file_hash) || !Digest::FromHex(file_hash, digest) || !manifest.FindPath(path_str, id))
+	{
+		return nullptr;
+	}
+
+	const ManifestEntry* expected = manifest.Select(id, bHasSDK);
+	if (expected == nullptr || !(expected->digest == digest))
+	{
+		return nullptr;
+	}
+
+	directory = std::make_unique<VpkDirectory>();
+	if (!directory->Load(dir_path))
+	{
+		directory.reset();
+	}
+	return directory.get();
+}
+
+//Checks VPK archives by the crc of every packed file in their _dir.vpk instead of hashing them whole, used with --vpk
+//Archives stay in files to be hashed if their _dir.vpk does not match hashes.json or any of their packed files are compressed and not in vpkentries.r5hv
+//Returns true if a damaged archive was found
+bool CheckVpkArchives(std::vector<fs::path>& files, bool bHasSDK)
+{
+	struct Archive
+	{
+		std::string path_str;
+		const ManifestEntry* expected = nullptr;
+		MappedFile mapped;
+		bool useDigests = false;
+		std::vector<const VpkEntry*> damaged;
+	};
+
+	std::map<std::string, std::unique_ptr<VpkDirectory>> directories;
+	std::vector<Archive> archives;
+	std::vector<std::pair<size_t, const VpkEntry*>> entries;
+	std::vector<fs::path> hashed;
+
+	for (fs::path& file : files)
+	{
+		Archive archive;
+		archive.path_str = InstallPath(file);
+
+		fs::path dir_path;
+		uint16_t index = 0;
+		uint32_t id;
+		const VpkDirectory* directory = nullptr;
+
+		bool listed = manifest.FindPath(archive.path_str, id) && (archive.expected = manifest.Select(id, bHasSDK)) != nullptr;
+
+		//An archive the cache already has a matching hash for is only looked up by the normal hashing, which is cheaper than any check here
+		FileIdentity identity;
+		Digest cached;
+		if (listed && useCache && !rehash && GetFileIdentity(file, identity) && hashCache.Peek(identity, cached) && cached == archive.expected->digest)
+		{
+			hashed.push_back(std::move(file));
+			continue;
+		}
+
+		if (listed && FindVpkDirectory(file, dir_path, index))
+		{
+			directory = LoadCheckedDirectory(dir_path, bHasSDK, directories);
+		}
+
+		std::vector<const VpkEntry*> packed;
+		bool checkable = directory != nullptr;
+		archive.useDigests = hasVpkManifest && archive.expected != nullptr && archive.expected->variant != Variant::SDK;
+
+		for (size_t i = 0; checkable && i < directory->Entries().size(); i++)
+		{
+			const VpkEntry& entry = directory->Entries()[i];
+			Digest digest;
+			if (entry.archive == index)
+			{
+				checkable = !entry.Compressed() || (archive.useDigests && vpkManifest.Find(archive.path_str, entry.path, digest));
+				packed.push_back(&entry);
+			}
+		}
+
+		if (!checkable || packed.empty() || !archive.mapped.Open(file))
+		{
+			hashed.push_back(std::move(file));
+			continue;
+		}
+
+		for (const VpkEntry* entry : packed)
+		{
+			entries.push_back({ archives.size(), entry });
+		}
+		archives.push_back(std::move(archive));
+	}
+
+	files = std::move(hashed);
+
+	if (archives.empty())
+	{
+		return false;
+	}
+
+	std::cout << "Checking " << entries.size() << " packed files in " << archives.size() << " VPK archives" << std::endl;
+
+	//Packed files are spread over the workers rather than whole archives, the largest archives hold most of them
+	ParallelFor(entries.size(), threadCount, [&](size_t i)
+	{
+		Archive& archive = archives[entries[i].first];
+
+		if (CheckPackedFile(archive.path_str, *entries[i].second, archive.mapped, archive.useDigests) != VpkCheck::Ok)
+		{
+			std::lock_guard<std::mutex> lock(resultsMutex);
+			archive.damaged.push_back(entries[i].second);
+
+			if (failFast)
+			{
+				cancelHashing = true;
+			}
+		}
+	}, &cancelHashing);
+
+	bool bad_files = false;
+
+	for (Archive& archive : archives)
+	{
+		//An archive whose packed files all match is recorded with its expected hash so the results compare as found
+		vpkCheckedArchives.insert(results.Add(manifest, archive.path_str, archive.damaged.empty() ? archive.expected->digest : Digest()));
+
+		if (archive.damaged.empty())
+		{
+			std::cout << "OK: " << archive.path_str << std::endl;
+			continue;
+		}
+
+		bad_files = true;
+		badFiles[archive.path_str] = "Invalid File found";
+		std::cout << "MISMATCH: " << archive.path_str << std::endl;
+
+		std::sort(archive.damaged.begin(), archive.damaged.end());
+		std::cout << archive.damaged.size() << " packed files in " << archive.path_str << " are damaged" << std::endl;
+		for (const VpkEntry* entry : archive.damaged)
+		{
+			std::cout << "  " << entry->path << std::endl;
+		}
+	}
+
+	return bad_files;
+}
+
+//Checks the headers of every .rpak and .starpak in files against their real length before anything is hashed
+//Paks that look broken are reported as suspect and moved to the front of files, their hash decides whether they are damaged
+void CheckPakHeaders(std::vector<fs::path>& files, bool bHasSDK)
+{
+	//Starpaks are referenced like paks\Win64\common.starpak
+	std::set<std::string> starpaks;
+	for (uint32_t id = 0; id < manifest.PathCount(); id++)
+	{
+		std::string path(manifest.Path(id));
+		if (path.ends_with(".starpak") && manifest.Select(id, bHasSDK) != nullptr)
+		{
+			std::transform(path.begin(), path.end(), path.begin(), ::tolower);
+			starpaks.insert(path.substr(1));
+		}
+	}
+
+	auto hasStarpak = [&starpaks](std::string_view path)
+	{
+		std::string lower(path);
+		std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+		std::replace(lower.begin(), lower.end(), '/', '\\');
+		return starpaks.contains(lower);
+	};
+
+	std::vector<bool> suspect(files.size());
+
+	ParallelFor(files.size(), threadCount, [&](size_t i)
+	{
+		std::string extension = files[i].extension().u8string();
+		bool rpak = extension == ".rpak";
+
+		MappedFile pak;
+		if ((!rpak && extension != ".starpak") || !pak.Open(files[i]))
+		{
+			return;
+		}
+
+		std::string problem;
+		if (rpak ? CheckRPak(pak, hasStarpak, problem) : CheckStarPak(pak, problem))
+		{
+			return;
+		}
+
+		std::string path_str = InstallPath(files[i]);
+		uint32_t id;
+		if (!manifest.FindPath(path_str, id) || manifest.Select(id, bHasSDK) == nullptr)
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		suspect[i] = true;
+		std::cout << "SUSPECT: " << path_str << ": " << problem << ", hashing it first to confirm" << std::endl;
+	});
+
+	//A header check can be wrong, e.g. a starpak reference that is not resolved, so only the hash marks a pak as damaged
+	std::vector<fs::path> suspects;
+	std::vector<fs::path> others;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		(suspect[i] ? suspects : others).push_back(std::move(files[i]));
+	}
+
+	files = std::move(suspects);
+	files.insert(files.end(), std::make_move_iterator(others.begin()), std::make_move_iterator(others.end()));
+}
+
+//Checks only the packed files matching --packed against vpkentries.r5hv, reading just their bytes from the archives
+//Each archive's _dir.vpk is checked against hashes.json first since it says where the packed files are, returns true if bad files were found
+bool VerifyPackedFiles(bool bHasSDK)
+{
+	struct Archive
+	{
+		std::string path_str;
+		MappedFile mapped;
+		size_t damaged = 0;
+	};
+
+	struct Selected
+	{
+		uint32_t record;
+		size_t archive;
+		const VpkEntry* entry;
+	};
+
+	std::map<std::string, std::unique_ptr<VpkDirectory>> directories;
+	std::vector<Archive> archives;
+	std::vector<Selected> selected;
+	bool bad_files = false;
+
+	//Records are in archive order so each archive is opened once
+	std::unordered_map<std::string_view, const VpkEntry*> packed;
+	bool usable = false;
+
+	for (uint32_t i = 0; i < vpkManifest.Count(); i++)
+	{
+		std::string glob_path = std::string(vpkManifest.Archive(i)) + "\\" + std::string(vpkManifest.Entry(i));
+		std::replace(glob_path.begin(), glob_path.end(), '/', '\\');
+
+		if (std::none_of(packedPatterns.begin(), packedPatterns.end(), [&](const std::string& pattern) { return GlobMatch(pattern, glob_path); }))
+		{
+			continue;
+		}
+
+		if (archives.empty() || archives.back().path_str != vpkManifest.Archive(i))
+		{
+			Archive& archive = archives.emplace_back();
+			archive.path_str = vpkManifest.Archive(i);
+
+			fs::path file = fs::current_path() += archive.path_str;
+			fs::path dir_path;
+			uint16_t index;
+			uint32_t id;
+			const ManifestEntry* expected = manifest.FindPath(archive.path_str, id) ? manifest.Select(id, bHasSDK) : nullptr;
+			const VpkDirectory* directory = nullptr;
+
+			packed.clear();
+			usable = false;
+
+			if (expected == nullptr || expected->variant == Variant::SDK)
+			{
+				//Packed files are recorded from the base install so the SDK version of an archive has to be hashed whole
+				std::cout << "Packed files in " << archive.path_str << " are not listed for this install" << std::endl;
+			}
+			else if (!archive.mapped.Open(file))
+			{
+				bad_files = true;
+				badFiles[archive.path_str] = "File missing";
+				std::cout << "File missing: " << archive.path_str << std::endl;
+			}
+			else if (!FindVpkDirectory(file, dir_path, index) || (directory = LoadCheckedDirectory(dir_path, bHasSDK, directories)) == nullptr)
+			{
+				bad_files = true;
+				badFiles[archive.path_str] = "Invalid File found";
+				std::cout << "MISMATCH: the _dir.vpk of " << archive.path_str << " is missing or damaged" << std::endl;
+			}
+			else
+			{
+				for (const VpkEntry& entry : directory->Entries())
+				{
+					if (entry.archive == index)
+					{
+						packed[entry.path] = &entry;
+					}
+				}
+				usable = true;
+			}
+		}
+
+		if (!usable)
+		{
+			continue;
+		}
+
+		auto found = packed.find(vpkManifest.Entry(i));
+		selected.push_back({ i, archives.size() - 1, found != packed.end() ? found->second : nullptr });
+	}
+
+	std::cout << "Checking " << selected.size() << " packed files selected with --packed" << std::endl;
+
+	ParallelFor(selected.size(), threadCount, [&](size_t i)
+	{
+		Archive& archive = archives[selected[i].archive];
+
+		Digest digest;
+		bool ok = selected[i].entry != nullptr
+			&& HashVpkEntry(*selected[i].entry, archive.mapped, digest)
+			&& digest == vpkManifest.EntryDigest(selected[i].record);
+
+		if (!ok)
+		{
+			std::lock_guard<std::mutex> lock(resultsMutex);
+			archive.damaged++;
+			std::cout << "MISMATCH: " << archive.path_str << ": " << vpkManifest.Entry(selected[i].record) << std::endl;
+
+			if (failFast)
+			{
+				cancelHashing = true;
+			}
+		}
+	}, &cancelHashing);
+
+	for (Archive& archive : archives)
+	{
+		if (archive.damaged != 0)
+		{
+			bad_files = true;
+			badFiles[archive.path_str] = "Invalid File found";
+			std::cout << archive.damaged << " packed files in " << archive.path_str << " are damaged" << std::endl;
+		}
+	}
+
+	return bad_files;
+}
+
+//Adds the records of a hash cache to contentIndex, skipping files that changed since they were cached so nothing has to be read
+//Paths are shown with prefix in front, empty for this install
+void IndexCachedHashes(const HashCache& cache, const fs::path& root, const std::string& prefix)
+{
+	cache.ForEach([&](const FileIdentity& identity, std::string_view path, const Digest& digest)
 	{
-		curl_easy_getinfo((CURL*)puserData, CURLINFO_CONTENT_LENGTH_DOWNLOAD,&hashFileSize);
-		hashesJson = (char*)malloc((size_t)hashFileSize);
+		fs::path file = root;
+		file += std::string(path);
 
-		if (hashesJson == nullptr)
+		FileIdentity current;
+		if (GetFileIdentity(file, current) && current == identity)
 		{
-			//if the data buffer is nullptr then we return 0 as this will be an error condition for curl
-			free((void*)hashesJson);
-			return 0;
+			contentIndex.Add(prefix + std::string(path), identity, digest);
 		}
+	});
+}
+
+//Lists groups of files with the same content and the bytes that hard linking them would free
+//Uses the hashes from this run, this install's hash cache and the hash caches of any --duplicates-with installs
+void ReportDuplicates()
+{
+	//Files only in the cache were skipped by this run, for example by --only or --root
+	IndexCachedHashes(hashCache, fs::current_path(), "");
+
+	for (const std::string& install : duplicateInstalls)
+	{
+		HashCache other;
+		other.Load(fs::path(install) /= "hashcache.bin");
+		IndexCachedHashes(other, install, install);
+	}
+
+	std::vector<DuplicateGroup> groups = contentIndex.Duplicates();
+
+	uint64_t reclaimable = 0;
+	for (const DuplicateGroup& group : groups)
+	{
+		reclaimable += group.reclaimable;
+	}
+
+	std::cout << "\n" << groups.size() << " groups of duplicate files in " << contentIndex.Count() << " indexed files, " << reclaimable << " bytes reclaimable by hard linking" << std::endl;
+
+	for (const DuplicateGroup& group : groups)
+	{
+		std::cout << "\n" << group.copies << " copies of " << group.size << " bytes (" << group.reclaimable << " reclaimable), sha1 " << group.digest.ToHex() << std::endl;
 
+		for (size_t i = 0; i < group.files.size(); i++)
+		{
+			//Files are sorted by file index within a group so hard links are next to each other
+			bool linked = i > 0 && group.files[i - 1]->identity.device == group.files[i]->identity.device && group.files[i - 1]->identity.inode == group.files[i]->identity.inode;
+			std::cout << "  " << group.files[i]->path << (linked ? " (hard link)" : "") << std::endl;
+		}
 	}
+}
+
+//Fetches damaged and missing files from repairSource then checks them again, returns true if any are still bad
+//Only the damaged ranges are fetched for files in chunks.r5hc, other files are fetched whole
+bool RepairInstall(bool bHasSDK)
+{
+	RepairSource source;
+	source.Open(repairSource);
+
+	std::cout << "\nRepairing " << badFiles.size() << " files from " << repairSource << std::endl;
+
+	std::vector<std::string> repaired;
 
-	if ( hashFileSize - bytesWritten - nmemb <= 0 )
+	for (auto& [path, problem] : badFiles)
 	{
-		//If the buffer cannot contain this data update reallocate the buffer and double the extra needed capacity
-		char* newbuff = (char*)realloc((void*)hashesJson, (size_t)hashFileSize + (nmemb * size) * 2);
+		uint32_t id;
+		const ManifestEntry* expected = manifest.FindPath(path, id) ? manifest.Select(id, bHasSDK) : nullptr;
+		if (expected == nullptr)
+		{
+			continue;
+		}
+
+		fs::path file = fs::current_path() += path;
+
+		uint64_t size;
+		std::span<const Digest> chunks;
+		auto ranges = damagedRanges.find(path);
+
+		bool fetched;
+		if (ranges != damagedRanges.end() && chunkManifest.Find(path, expected->variant, size, chunks))
+		{
+			fetched = RepairRanges(source, file, path, ranges->second, size);
+		}
+		else
+		{
+			fetched = RepairWholeFile(source, file, path);
+		}
+
+		//Only trust the repair if the file now has the right hash
+		std::string path_str;
+		std::string file_hash;
+		Digest digest;
+
+		if (fetched && ComputeHash(file, path_str, file_hash) && Digest::FromHex(file_hash, digest) && digest == expected->digest)
+		{
+			std::cout << "Repaired: " << path << std::endl;
+			repaired.push_back(path);
 
-		if (newbuff == nullptr)
+			results.Add(manifest, path, digest);
+		}
+		else
 		{
-			//If realloc fails we must free the original memory manually
-			free((void*)hashesJson);
-			return 0;	
+			std::cout << "Repair failed: " << path << std::endl;
 		}
+	}
 
-		//If realloc succeeds set the hashesJson pointer to the new memory we just allocated
-		hashesJson = newbuff;
+	for (const std::string& path : repaired)
+	{
+		badFiles.erase(path);
+		damagedRanges.erase(path);
+	}
+
+	return !badFiles.empty();
+}
+
+//Compares the hashed files against both installs using the hashes already computed
+//Tells apart an SDK install, a Default install and a mix of the two
+void ReportProfiles(bool bHasSDK)
+{
+	std::vector<uint32_t> sdk_bad;
+	std::vector<uint32_t> default_bad;
+
+	for (bool sdk : { true, false })
+	{
+		std::vector<uint32_t>& bad = sdk ? sdk_bad : default_bad;
+		results.Compare(manifest, sdk, [&](Outcome outcome, uint32_t id)
+		{
+			//Archives checked with --vpk only have the hash of this install's profile, so they can't be compared against the other
+			if (outcome != Outcome::Extra && PathSelected(manifest.Path(id)) && !vpkCheckedArchives.contains(id))
+			{
+				bad.push_back(id);
+			}
+		});
+	}
 
-		//New size will be current size + 2x the pdata size
-		hashFileSize = hashFileSize + (nmemb * size) * 2;
+	if (!vpkCheckedArchives.empty())
+	{
+		std::cout << "\n" << vpkCheckedArchives.size() << " VPK archives checked by their packed files are not compared against both profiles" << std::endl;
 	}
 
-	memcpy((void*)&hashesJson[bytesWritten], pData, nmemb * size);
-	bytesWritten += nmemb;
+	std::cout << "\nSDK install: " << (sdk_bad.empty() ? "consistent" : std::to_string(sdk_bad.size()) + " files differ") << std::endl;
+	std::cout << "Default install: " << (default_bad.empty() ? "consistent" : std::to_string(default_bad.size()) + " files differ") << std::endl;
 
-	//Curl does not null terminate the data, do this for every "block" since we dont know when we are getting the last block
-	hashesJson[bytesWritten] = '\0';
+	if (sdk_bad.empty() || default_bad.empty())
+	{
+		bool matchesSDK = sdk_bad.empty() && (!default_bad.empty() || bHasSDK);
+		std::cout << "The install matches the " << (matchesSDK ? "SDK" : "Default") << " profile";
 
-	return nmemb;
-	
+		if (matchesSDK != bHasSDK)
+		{
+			std::cout << ", but gamesdk.dll is " << (bHasSDK ? "present" : "missing");
+		}
+		std::cout << std::endl;
+		return;
+	}
+
+	//Both lists are in path id order, so one pass sorts every file into which profile it belongs to
+	std::cout << "The install matches neither profile:" << std::endl;
+
+	size_t s = 0;
+	size_t d = 0;
+	while (s < sdk_bad.size() || d < default_bad.size())
+	{
+		if (d == default_bad.size() || (s < sdk_bad.size() && sdk_bad[s] < default_bad[d]))
+		{
+			std::cout << "Default version: " << manifest.Path(sdk_bad[s++]) << std::endl;
+		}
+		else if (s == sdk_bad.size() || default_bad[d] < sdk_bad[s])
+		{
+			std::cout << "SDK version: " << manifest.Path(default_bad[d++]) << std::endl;
+		}
+		else
+		{
+			std::cout << "Matches neither: " << manifest.Path(sdk_bad[s]) << std::endl;
+			s++;
+			d++;
+		}
+	}
 }
 
-bool DownloadHashJson()
+//Hashes every file in the install and checks them against hashes.json, returns true if bad files were found
+bool VerifyHashes(bool bHasSDK)
 {
-	
-	CURL* curl = curl_easy_init();
+	bool bad_files = false;
+
+	std::vector<fs::path> files;
+
+	if (!onlyPatterns.empty())
+	{
+		//Only the selected manifest entries are hashed, the install is not searched so extra files are not found
+		for (uint32_t id = 0; id < manifest.PathCount(); id++)
+		{
+			if (manifest.Select(id, bHasSDK) != nullptr && PathSelected(manifest.Path(id)))
+			{
+				fs::path file = fs::current_path() += manifest.Path(id);
+				if (fs::exists(file))
+				{
+					files.push_back(file);
+				}
+			}
+		}
+
+		std::cout << "Verifying " << files.size() << " files selected with --only" << std::endl;
+	}
+	else
+	{
+		//Check files in the base directory
+		if (RootSelected("base"))
+		{
+			CollectFiles(fs::current_path(), false, files);
+		}
+
+		//Check whole directories
+		for (const char* ittr : paths)
+		{
+			if (!RootSelected(RootShardName(ittr)))
+			{
+				continue;
+			}
+
+			fs::path a = fs::current_path() += ittr;
+			std::cout << "Verifying: " << a << std::endl;
+			CollectFiles(a, true, files);
+		}
+	}
+
+	std::cout << std::endl;
+
+	//A missing file fails the check without hashing anything
+	if (failFast)
+	{
+		for (uint32_t id = 0; id < manifest.PathCount(); id++)
+		{
+			if (manifest.Select(id, bHasSDK) != nullptr && PathSelected(manifest.Path(id)) && !fs::exists(fs::current_path() += manifest.Path(id)))
+			{
+				badFiles[std::string(manifest.Path(id))] = "File missing";
+				std::cout << "File missing: " << manifest.Path(id) << std::endl;
+				return true;
+			}
+		}
+	}
+
+	uint32_t extra_files = 0;
+	uint64_t extra_bytes = 0;
+	uint32_t other_profile_files = 0;
+
+	//Files without an entry for this install are found with one path lookup each and listed without being read
+	//--profiles compares against the other install too so files only it has are still hashed
+	if (!hashExtras)
+	{
+		std::vector<fs::path> expected_files;
+		for (fs::path& file : files)
+		{
+			std::string path_str = InstallPath(file);
+			uint32_t id;
+
+			if (manifest.FindPath(path_str, id) && (checkProfiles || manifest.Select(id, bHasSDK) != nullptr))
+			{
+				expected_files.push_back(std::move(file));
+				continue;
+			}
+
+			std::error_code ec;
+			uintmax_t size = fs::file_size(file, ec);
+			extra_bytes += ec ? 0 : size;
+			extra_files++;
+			std::cout << "UNEXPECTED: " << path_str << std::endl;
+		}
+		files = std::move(expected_files);
+	}
+
+	if (vpkEntries && !cancelHashing && CheckVpkArchives(files, bHasSDK))
+	{
+		bad_files = true;
+	}
+
+	if (cancelHashing)
+	{
+		return true;
+	}
+
+	//Files most likely to stop the game from starting are hashed and reported first
+	SortByPriority(files);
+
+	//Structurally broken paks are found in microseconds and hashed before anything else
+	CheckPakHeaders(files, bHasSDK);
+
+	//Each file is checked against hashes.json as soon as it is hashed
+	ParallelFor(files.size(), threadCount, [&](size_t i)
+	{
+		std::string path_str;
+		std::string file_hash;
+		Digest digest;
+
+		if (!ComputeHash(files[i], path_str, file_hash) || !Digest::FromHex(file_hash, digest))
+		{
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(resultsMutex);
+
+		uint32_t id = results.Add(manifest, path_str, digest);
+		const ManifestEntry* expected = id < manifest.PathCount() ? manifest.Select(id, bHasSDK) : nullptr;
+
+		//--profiles keeps files only the other install has, they are in hashes.json so they are not extras
+		if (expected == nullptr && checkProfiles && id < manifest.PathCount())
+		{
+			other_profile_files++;
+			std::cout << "OTHER PROFILE: " << path_str << std::endl;
+		}
+		else if (expected == nullptr)
+		{
+			extra_files++;
+			std::cout << "UNEXPECTED: " << path_str << std::endl;
+		}
+		else if (!(expected->digest == digest))
+		{
+			bad_files = true;
+			badFiles[path_str] = "Invalid File found";
+			std::cout << "MISMATCH: " << path_str << std::endl;
+
+			if (failFast)
+			{
+				cancelHashing = true;
+			}
+			else
+			{
+				//Reading the file again takes a while, let the other workers report in the meantime
+				Variant variant = expected->variant;
+				lock.unlock();
+
+				if (hasChunks)
+				{
+					ReportDamagedRanges(files[i], path_str, variant);
+				}
+				ReportDamagedEntries(files[i], path_str, variant);
+			}
+		}
+		else
+		{
+			std::cout << "OK: " << path_str << std::endl;
+		}
+	}, &cancelHashing);
+
+	if (cancelHashing)
+	{
+		return true;
+	}
+
+	//Only files that were never found are left to report
+	results.Sort();
+
+	results.Compare(manifest, bHasSDK, [&](Outcome outcome, uint32_t id)
+	{
+		if (outcome != Outcome::Missing || !PathSelected(manifest.Path(id)))
+		{
+			return;
+		}
+
+		bad_files = true;
+		badFiles[std::string(manifest.Path(id))] = "File missing";
+		std::cout << "File missing: " << manifest.Path(id) << std::endl;
+	});
+
+	if (extra_files != 0)
+	{
+		std::cout << extra_files << " files were found that are not in hashes.json";
+		if (!hashExtras)
+		{
+			std::cout << " (" << extra_bytes << " bytes, not read)";
+		}
+		std::cout << std::endl;
+	}
+
+	if (other_profile_files != 0)
+	{
+		std::cout << other_profile_files << " files were found that only the " << (bHasSDK ? "Default" : "SDK") << " profile has" << std::endl;
+	}
+
+	if (checkProfiles)
+	{
+		ReportProfiles(bHasSDK);
+	}
+
+	return bad_files;
+}
+
+void PrintCacheSummary()
+{
+	size_t lookups = hashCache.Hits() + hashCache.Misses();
+	std::cout << "\nHash cache: " << hashCache.Hits() << " hits, " << hashCache.Misses() << " misses";
+	if (lookups > 0)
+	{
+		std::cout << " (" << (hashCache.Hits() * 100 / lookups) << "% hit rate)";
+	}
+	std::cout << std::endl;
+}
+
+//Prints how many hashes.json entries were added, changed or removed by a build
+void ReportManifestChanges(const Manifest& previous, const Manifest& current)
+{
+	size_t added = 0;
+	size_t changed = 0;
+	size_t removed = 0;
+
+	//Both manifests are sorted by path, so walk them together
+	uint32_t p = 0;
+	uint32_t c = 0;
+	while (p < previous.PathCount() || c < current.PathCount())
+	{
+		if (c == current.PathCount() || (p < previous.PathCount() && previous.Path(p) < current.Path(c)))
+		{
+			removed++;
+			p++;
+		}
+		else if (p == previous.PathCount() || current.Path(c) < previous.Path(p))
+		{
+			added++;
+			c++;
+		}
+		else
+		{
+			std::span<const ManifestEntry> before = previous.Entries(p);
+			std::span<const ManifestEntry> after = current.Entries(c);
+
+			if (!std::equal(before.begin(), before.end(), after.begin(), after.end(), [](const ManifestEntry& a, const ManifestEntry& b) { return a.variant == b.variant && a.digest == b.digest; }))
+			{
+				changed++;
+				std::cout << "Changed: " << current.Path(c) << std::endl;
+			}
+			p++;
+			c++;
+		}
+	}
+
+	std::cout << "\n" << added << " added, " << changed << " changed, " << removed << " removed since the previous hashes.json" << std::endl;
+}
+
+//Writes the current verification state to verifystatus.json so it can be queried at any time while watching
+void WriteStatus(const char* state)
+{
+	nlohmann::json status = {
+		{ "state", state },
+		{ "updated", (int64_t)time(nullptr) },
+		{ "bad_files", badFiles }
+	};
+
+	std::string text = status.dump(1);
+	WriteFileAtomic(fs::current_path() /= "verifystatus.json", text.data(), text.size());
+}
+
+//Rehashes a single manifest path after it changed on disk
+void RecheckEntry(uint32_t pathId, bool bHasSDK)
+{
+	std::string key(manifest.Path(pathId));
+
+	badFiles.erase(key);
+
+	//The new hash replaces the old result in place, a file that is gone or can't be read any more is treated as missing
+	fs::path file = fs::current_path() += key;
+	if (!fs::is_regular_file(file) || !HashFile(file, false))
+	{
+		results.Remove(pathId);
+	}
+
+	if (const char* problem = CheckEntry(pathId, bHasSDK))
+	{
+		badFiles[key] = problem;
+		std::cout << problem << ": " << key << std::endl;
+	}
+	else
+	{
+		std::cout << "File OK: " << key << std::endl;
+	}
+}
+
+//Keeps the verification state up to date by rechecking files as they change, only returns if watching fails
+void WatchInstall(bool bHasSDK, const fs::path& cache_path)
+{
+	DirectoryWatcher watcher;
+
+	if (!watcher.Open(fs::current_path()))
+	{
+		std::cout << "Failed to watch the install for changes" << std::endl;
+		return;
+	}
+
+	WriteStatus(badFiles.empty() ? "clean" : "damaged");
+	std::cout << "\nWatching for changes, current status is written to verifystatus.json" << std::endl;
+
+	std::vector<std::string> changed;
+	bool overflow = false;
+
+	while (watcher.Wait(changed, overflow))
+	{
+		//Give whatever is writing the files a moment to finish, changes in the meantime are queued for the next wait
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+
+		std::set<uint32_t> recheck;
+
+		if (overflow || std::find(changed.begin(), changed.end(), "\\gamesdk.dll") != changed.end())
+		{
+			//Installing or removing the sdk changes which hash every file is expected to have
+			bHasSDK = fs::exists("gamesdk.dll");
+
+			for (uint32_t id = 0; id < manifest.PathCount(); id++)
+			{
+				recheck.insert(id);
+			}
+		}
+		else
+		{
+			for (const std::string& path : changed)
+			{
+				uint32_t id;
+				if (manifest.FindPath(path, id))
+				{
+					recheck.insert(id);
+					continue;
+				}
+
+				//A directory was renamed or deleted, recheck everything that was in it
+				std::string prefix = path + "\\";
+				for (id = manifest.LowerBound(prefix); id < manifest.PathCount() && manifest.Path(id).starts_with(prefix); id++)
+				{
+					recheck.insert(id);
+				}
+			}
+		}
+
+		//Changes to files that are not in hashes.json do not affect the result
+		if (recheck.empty())
+		{
+			continue;
+		}
+
+		WriteStatus("verifying");
+
+		for (uint32_t id : recheck)
+		{
+			if (PathSelected(manifest.Path(id)))
+			{
+				RecheckEntry(id, bHasSDK);
+			}
+		}
 
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curlWriteCallback);
-	curl_easy_setopt(curl, CURLOPT_URL, "https://raw.githubusercontent.com/O-Robotic/r5r-file-hasher/master/hashes.json");
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, curl);
-	CURLcode ret = curl_easy_perform(curl);
-	
-	if (ret != CURLE_OK)
-	{
-		std::cout << "Failed to download the hash list." << std::endl;
-		curl_easy_cleanup(curl);
-		return false;
-	}
+		if (useCache && hashCache.Save(cache_path, false))
+		{
+			hashCache.Load(cache_path);
+		}
 
-	curl_easy_cleanup(curl);
+		WriteStatus(badFiles.empty() ? "clean" : "damaged");
+	}
 
-	return true;
-	
+	std::cout << "Stopped watching for changes" << std::endl;
 }
 
-//Main hashing function
-void HashFile(const fs::path& path_in, const bool gen_hash)
-{
-
-	CSha1* sha = new CSha1();
-	Sha1_Init(sha);
+//Options that are followed by a value
+const char* valueOptions[]{ "--only", "--only-list", "--priority", "--repair", "--threads", "--packed", "--duplicates-with", "--root" };
 
-	unsigned char* buf = (unsigned char*)malloc(ReadSize);
+//Exits if an option is unknown, is missing its value or names something that can't be used
+void ParseArgs(int argc, char* argv[])
+{
+	bool badArgs = false;
 
-	if (buf)
+	for (int i = 1; i < argc; i++)
 	{
-		FILE* file = fopen(path_in.u8string().c_str(), "rb");
+		std::string arg = argv[i];
 
-		size_t filePos = 0;
-
-		bool didHash = false;
-
-		if (file)
+		if (arg == "--metadata")
+		{
+			metadataOnly = true;
+		}
+		else if (arg == "--no-cache")
+		{
+			useCache = false;
+		}
+		else if (arg == "--rehash")
+		{
+			rehash = true;
+		}
+		else if (arg == "--watch")
 		{
-			while (filePos = fread(buf, 1, ReadSize, file))
+			watchMode = true;
+		}
+		else if (arg == "--bench-manifest")
+		{
+			benchManifest = true;
+		}
+		else if (arg == "--only" && i + 1 < argc)
+		{
+			AddOnlyPattern(argv[++i]);
+		}
+		else if (arg == "--only-list" && i + 1 < argc)
+		{
+			if (!ReadOnlyList(argv[++i]))
 			{
-				Sha1_Update(sha, buf, filePos);
+				std::cout << "Failed to read " << argv[i] << std::endl;
+				badArgs = true;
 			}
-			didHash = true;
-			fclose(file);
 		}
-		else
+		else if (arg == "--priority" && i + 1 < argc)
 		{
-			std::cout << "Failed to open: " << path_in.u8string().c_str() << std::endl;
+			priorityRules.push_back(argv[++i]);
 		}
-
-		unsigned char result[20];
-		Sha1_Final(sha, result);
-
-		std::stringstream shastr;
-		shastr << std::hex << std::setfill('0');
-		for (const auto& byte : result)
+		else if (arg == "--repair" && i + 1 < argc)
 		{
-			shastr << std::setw(2) << (int)byte;
+			repairSource = argv[++i];
 		}
-
-		free(buf);
-		delete sha;
-
-		std::string file_hash = shastr.str();
-
-		if (didHash)
+		else if (arg == "--chunks")
+		{
+			buildChunks = true;
+		}
+		else if (arg == "--fail-fast")
+		{
+			failFast = true;
+		}
+		else if (arg == "--threads" && i + 1 < argc)
+		{
+			threadCount = (unsigned)std::max(0, atoi(argv[++i]));
+		}
+		else if (arg == "--vpk")
+		{
+			vpkEntries = true;
+		}
+		else if (arg == "--packed" && i + 1 < argc)
+		{
+			//A whole archive can be given like a folder
+			packedPatterns.push_back(argv[++i]);
+			packedPatterns.push_back(packedPatterns.back() + "\\**");
+		}
+		else if (arg == "--hash-extras")
+		{
+			hashExtras = true;
+		}
+		else if (arg == "--duplicates")
 		{
-			std::string path_str = path_in.u8string();
-			std::size_t ind = path_str.find(fs::current_path().u8string());
-			if (shouldAddSDK)
+			findDuplicates = true;
+		}
+		else if (arg == "--duplicates-with" && i + 1 < argc)
+		{
+			findDuplicates = true;
+			duplicateInstalls.push_back(argv[++i]);
+		}
+		else if (arg == "--profiles")
+		{
+			checkProfiles = true;
+		}
+		else if (arg == "--root" && i + 1 < argc)
+		{
+			std::string name = RootShardName(argv[++i]);
+
+			size_t root = std::size(paths);
+			for (size_t k = 0; k < std::size(paths); k++)
 			{
-				path_str.erase(ind, (fs::current_path() += "\\SDK").u8string().length());
+				if (RootShardName(paths[k]) == name)
+				{
+					root = k;
+				}
 			}
-			else
+
+			if (root == std::size(paths) && name != "base")
 			{
-				path_str.erase(ind, fs::current_path().u8string().length());
+				std::cout << "Unknown root: " << argv[i] << std::endl;
+				badArgs = true;
 			}
-#ifdef BUILDER
-			if (!gen_hash)
+			else if (!selectedRoots[root])
 			{
-				unknown[path_str] = file_hash;
+				selectedRoots[root] = true;
+				onlyRoots.push_back(name);
 			}
-			else
-			{
+		}
+		else
+		{
+			//Options that take a value end up here when it is the last argument
+			bool needsValue = std::find(std::begin(valueOptions), std::end(valueOptions), arg) != std::end(valueOptions);
+			std::cout << (needsValue ? "Missing value for option: " : "Unknown option: ") << arg << std::endl;
+			badArgs = true;
+		}
+	}
 
-				if (shouldAddSDK)
-				{
-					if (known[path_str].is_object())
-					{
-						known[path_str] += {"Default", file_hash };
-					}
-					else
-					{
-						known[path_str] = { {"SDK", file_hash }};
-					}
-				}
-				else if (known[path_str].is_object())
-				{
-					known[path_str] += {"Default", file_hash};
-				}
-				else
-				{
-					known[path_str] = file_hash;
-				}
+	//Checking everything instead of what was asked for would be misleading
+	if (badArgs)
+	{
+		Pause();
+		exit(EXIT_FAILURE);
+	}
 
-				std::cout << "Hashed: " << path_str << "\nHash: " << file_hash << "\n" << std::endl;
-			}
-#endif
+	if (checkProfiles && metadataOnly)
+	{
+		std::cout << "--profiles needs every file hashed and is ignored with --metadata" << std::endl;
+	}
 
-#ifndef BUILDER
-			unknown[path_str] = file_hash;
-#endif
-		}
+	if (findDuplicates && (metadataOnly || !packedPatterns.empty()))
+	{
+		std::cout << "--duplicates needs every file hashed and is ignored with --metadata and --packed" << std::endl;
+		findDuplicates = false;
 	}
-	else
+
+	if (!repairSource.empty() && metadataOnly)
 	{
-		std::cout << "Failed to allocate needed memory" << std::endl;
-		system("pause");
-		exit(EXIT_FAILURE);
+		std::cout << "--repair needs every file hashed and is ignored with --metadata" << std::endl;
+	}
+
+	if (!packedPatterns.empty() && (watchMode || checkProfiles))
+	{
+		std::cout << "--watch and --profiles need every file hashed and are ignored with --packed" << std::endl;
+		watchMode = false;
+		checkProfiles = false;
 	}
-}
 
+	if (failFast && watchMode)
+	{
+		std::cout << "--watch is ignored with --fail-fast" << std::endl;
+		watchMode = false;
+	}
+}
 
-int main()
+int main(int argc, char* argv[])
 {
 
 	Sha1Prepare();
 
+	ParseArgs(argc, argv);
+
 	bool bad_files = false;
 
 	std::cout << logo << std::endl;
 	std::cout << "R5R file hash check" << std::endl;
 	
-	if (!fs::exists("r5apex.exe")) {
-		std::cout << "Please run this tool in the folder with r5apex.exe" << std::endl;
-		system("pause");
-		exit(EXIT_FAILURE);
-	}
-
-#ifndef BUILDER
-	if (!fs::exists("hashes.json"))
+	if (benchManifest)
 	{
-		bool hashDL = DownloadHashJson();
-		if (!hashDL)
-		{
-			std::cout << "Hashes file could not be downloaded and a hashes json was not found." << std::endl;
-			system("pause");
-			return EXIT_FAILURE;
-		}
-
-		known = nlohmann::json::parse(hashesJson);
-		free((void*)hashesJson);
+		return RunManifestBenchmark(fs::current_path() /= "hashes.json") ? EXIT_SUCCESS : EXIT_FAILURE;
 	}
-	else
-	{
-		fs::path hashes_path = fs::current_path() /= "hashes.json";
-		std::ifstream hashes_file_in(hashes_path, std::ios::in);
-
-
-		if (hashes_file_in.good() && hashes_file_in)
-		{
-			hashes_file_in >> known;
-			hashes_file_in.close();
-		}
-		else
-		{
-			std::cout << "\nFailed to read hashes.json, make sure you put it and this exe in the folder with r5apex" << std::endl;
-			system("pause");
-			return EXIT_FAILURE;
-		}
 
+	if (!fs::exists("r5apex.exe")) {
+		std::cout << "Please run this tool in the folder with r5apex.exe" << std::endl;
+		Pause();
+		exit(EXIT_FAILURE);
 	}
 
-#endif // BUILDER
-
 #ifdef BUILDER
 		
 	//Add select menu if builder is defined
 	
 	fs::path hashes_path = fs::current_path() /= "hashes.json";
+	fs::path sizes_path = fs::current_path() /= "sizes.json";
+	fs::path binary_path = fs::current_path() /= "hashes.r5hm";
+	fs::path cache_path = fs::current_path() /= "hashcache.bin";
 
 	int i;
 
@@ -275,6 +2040,31 @@ int main()
 	std::cin >> i;
 	if (i == 1)
 	{
+		//Files that have not changed since the last build reuse their cached hash, only changed files are read
+		if (useCache)
+		{
+			hashCache.Load(cache_path);
+		}
+
+		//A chunks.r5hc older than hashes.json was left by a build before one without --chunks, so it may be out of date
+		fs::path chunks_path = fs::current_path() /= "chunks.r5hc";
+		if (buildChunks && useCache && fs::exists(chunks_path) && fs::exists(hashes_path) && fs::last_write_time(chunks_path) >= fs::last_write_time(hashes_path))
+		{
+			previousChunks.Load(chunks_path);
+		}
+
+		//Keep the previous hashes and sizes around to report what changed in this build and write hashes.delta.json against
+		Manifest previous;
+		bool hasPrevious = false;
+		bool hasPreviousSizes = false;
+		{
+			std::ifstream previous_hashes(hashes_path, std::ios::in | std::ios::binary);
+			hasPrevious = previous_hashes.good() && previous.Load(previous_hashes, ManifestFile::Hashes);
+
+			std::ifstream previous_sizes(sizes_path, std::ios::in | std::ios::binary);
+			hasPreviousSizes = hasPrevious && previous_sizes.good() && previous.Load(previous_sizes, ManifestFile::Sizes);
+		}
+
 		const fs::path sdkPath = fs::current_path() += "\\SDK";
 
 		if (fs::exists(sdkPath))
@@ -283,198 +2073,172 @@ int main()
 
 			std::cout << "Hashing SDK files" << std::endl;
 
+			std::vector<fs::path> files;
 			for (const char* ittr : paths)
 			{
-
 				fs::path dir = sdkPath;
 				dir += ittr;
-
-				
-				for (auto& file : fs::recursive_directory_iterator(dir))
-				{
-					if (std::find(std::begin(excluded_files), std::end(excluded_files), file.path().filename().u8string()) != std::end(excluded_files))
-					{
-						continue;
-					}
-
-					if (file.path().has_filename() && file.path().has_extension())
-					{
-						HashFile(file, true);
-					}
-				}
+				CollectFiles(dir, true, files);
 			}
+			CollectFiles(sdkPath, false, files);
 
-			for (auto& file : fs::directory_iterator(sdkPath))
-			{
-				//Check if file is in excluded files list
-				if (std::find(std::begin(excluded_files), std::end(excluded_files), file.path().filename().u8string()) != std::end(excluded_files))
-				{
-					continue;
-				}
-
-				if (file.path().has_filename() && file.path().has_extension())
-				{
-					HashFile(file, true);
-				}
-			}
+			ParallelFor(files.size(), threadCount, [&files](size_t index) { HashFile(files[index], true); });
 		}
 
 		shouldAddSDK = false;
 
-		//Hash files in base dir
-		for (auto& file : fs::directory_iterator(fs::current_path()))
+		//Hash files in base dir and directories
+		std::vector<fs::path> files;
+		CollectFiles(fs::current_path(), false, files);
+		for (const char* ittr : paths)
 		{
-			if (std::find(std::begin(excluded_files), std::end(excluded_files), file.path().filename().u8string()) != std::end(excluded_files))
-			{
-				continue;
-			}
+			CollectFiles(fs::current_path() += ittr, true, files);
+		}
 
-			if ((file.path().has_filename()) && (file.path().has_extension()))
-			{
-				HashFile(file, true);
-			}
+		ParallelFor(files.size(), threadCount, [&files](size_t index) { HashFile(files[index], true); });
+
+		//Write hashes.json file
+		SortBuiltFiles(builtFiles);
+
+		std::string hashes_text;
+		WriteManifestText(builtFiles, ManifestFile::Hashes, hashes_text);
+		std::ofstream hashes_file(hashes_path, std::ios::out | std::ios::trunc);
+		hashes_file << hashes_text;
+		hashes_file.close();
+
+		//Write sizes.json file
+		std::string sizes_text;
+		WriteManifestText(builtFiles, ManifestFile::Sizes, sizes_text);
+		std::ofstream sizes_file(sizes_path, std::ios::out | std::ios::trunc);
+		sizes_file << sizes_text;
+		sizes_file.close();
+
+		//Write compressed copies for clients to download
+		if (!WriteGzipFile(fs::current_path() /= "hashes.json.gz", hashes_text)
+			|| !WriteGzipFile(fs::current_path() /= "sizes.json.gz", sizes_text))
+		{
+			std::cout << "Failed to write hashes.json.gz and sizes.json.gz" << std::endl;
 		}
 
-		//Hash Directories
-		for (const char* ittr : paths)
+		//Write hashes.r5hm with the same hashes and sizes
+		Manifest binary;
+		if (!binary.Load(hashes_text.data(), hashes_text.size(), ManifestFile::Hashes)
+			|| !binary.Load(sizes_text.data(), sizes_text.size(), ManifestFile::Sizes)
+			|| !binary.WriteBinary(binary_path))
 		{
+			std::cout << "Failed to write hashes.r5hm" << std::endl;
+		}
 
-			fs::path dir = fs::current_path() += ittr;
+		//The last build's chunks.r5hc has to be unmapped before it can be replaced
+		previousChunks = ChunkManifest();
 
-			for (auto& file : fs::recursive_directory_iterator(dir))
-			{
-				if (std::find(std::begin(excluded_files), std::end(excluded_files), file.path().filename().u8string()) != std::end(excluded_files))
-				{
-					continue;
-				}
+		if (buildChunks && !chunkManifest.Write(chunks_path))
+		{
+			std::cout << "Failed to write chunks.r5hc" << std::endl;
+		}
 
-				if ((file.path().has_filename()) && (file.path().has_extension()))
-				{
-					HashFile(file, true);
-				}
-			}
+		if (vpkEntries && !vpkManifest.Write(fs::current_path() /= "vpkentries.r5hv"))
+		{
+			std::cout << "Failed to write vpkentries.r5hv" << std::endl;
 		}
 
-		//Write hashes.json file
-		std::ofstream hashes_file(hashes_path, std::ios::out | std::ios::trunc);
-		hashes_file << known.dump(1);
-		hashes_file.close();
+		//Clients that already have the previous build's manifest only download what changed
+		if (hasPreviousSizes && !WriteManifestDelta(previous, binary, fs::current_path() /= "hashes.delta.json"))
+		{
+			std::cout << "Failed to write hashes.delta.json" << std::endl;
+		}
+
+		if (!WriteManifestShards(binary, paths, fs::current_path() /= "shards"))
+		{
+			std::cout << "Failed to write the manifest shards" << std::endl;
+		}
+
+		if (useCache)
+		{
+			hashCache.Save(cache_path, true);
+			PrintCacheSummary();
+		}
+
+		if (hasPrevious)
+		{
+			ReportManifestChanges(previous, binary);
+		}
 
 	}
 	else
 	{
-		std::ifstream hashes_file_in(hashes_path, std::ios::in);
-
-		if (hashes_file_in.good() && hashes_file_in)
+#else
+		fs::path cache_path = fs::current_path() /= "hashcache.bin";
+#endif
+		if (!LoadKnownGood(metadataOnly))
 		{
-			hashes_file_in >> known;
-			hashes_file_in.close();
+			Pause();
+			return EXIT_FAILURE;
 		}
-#endif
+
 		//If user has sdk installed use different set of hashes for sdk modified files
-		bool bHasSDK = false;
+		bool bHasSDK = fs::exists("gamesdk.dll");
 
-		//Check files in the base directory and check if user has the sdk installed
-		for (auto& file : fs::directory_iterator(fs::current_path()))
+		//Damaged files are narrowed down to the chunks that differ if chunks.r5hc is next to the exe
+		hasChunks = fs::exists("chunks.r5hc") && chunkManifest.Load(fs::current_path() /= "chunks.r5hc");
+
+		//Compressed packed files can be checked, and --packed used, if vpkentries.r5hv is next to the exe
+		hasVpkManifest = fs::exists("vpkentries.r5hv") && vpkManifest.Load(fs::current_path() /= "vpkentries.r5hv");
+
+		if (!packedPatterns.empty() && !hasVpkManifest)
 		{
-			if (file.path().has_filename() && file.path().has_extension())
-			{
-				if (file.path().filename().u8string() == "gamesdk.dll")
-				{
-					bHasSDK = true;
-				}
-				HashFile(file, false);
-			}
+			std::cout << "--packed needs vpkentries.r5hv next to the exe, checking whole files instead" << std::endl;
+			packedPatterns.clear();
 		}
 
-		//Check whole directories
-		for (const char* ittr : paths)
+		if (useCache)
 		{
-			fs::path a = fs::current_path() += ittr;
-			std::cout << "Verifying: " << a << std::endl;
+			hashCache.Load(cache_path);
+		}
 
-			for (auto & file : fs::recursive_directory_iterator(a))
-			{
-				if (file.path().has_filename() && file.path().has_extension())
-				{
-					HashFile(file, false);
-				}
-			}
+		if (!packedPatterns.empty())
+		{
+			bad_files = VerifyPackedFiles(bHasSDK);
+		}
+		else if (metadataOnly)
+		{
+			bad_files = VerifyMetadata(bHasSDK);
+		}
+		else
+		{
+			bad_files = VerifyHashes(bHasSDK);
 		}
 
-		std::cout << std::endl;
+		if (bad_files && !repairSource.empty() && !metadataOnly)
+		{
+			bad_files = RepairInstall(bHasSDK);
+		}
 
-		//Check hashes vs hash file
-		//unknown = hashes generated
-		//known = known good hashes from file
-		for (auto& ittr : known.items())
+		if (findDuplicates)
 		{
+			ReportDuplicates();
+		}
 
-			//If ittr is an object we should expect it may or may not exist depending on if the user has the sdk
-			if (ittr.value().is_object())
-			{
-				if (bHasSDK) //Do we have the sdk installed
-				{
-					
-					//If we have the sdk installed every file from the json should exist
-					if (!unknown.contains(ittr.key()))
-					{
-						bad_files = true;
-						std::cout << "File missing: " << ittr.key() << std::endl;
-						continue;
-					}
-					
-					//If we do then check the value against the "SDK" hash
-					if (unknown[ittr.key()] != ittr.value()["SDK"])
-					{
-						bad_files = true;
-						std::cout << "Invalid File found: " << ittr.key() << std::endl;
-					}
-				}
-				else
-				{
+		if (useCache)
+		{
+			//A full check sees every file so entries for files that no longer exist can be dropped
+			//Checks of part of the install, and --vpk which does not hash the archives, would drop entries for files that still exist
+			bool fullCheck = !metadataOnly && !failFast && onlyPatterns.empty() && onlyRoots.empty() && packedPatterns.empty() && !vpkEntries;
+			hashCache.Save(cache_path, fullCheck);
+			PrintCacheSummary();
+		}
 
-					//Does the current known hash object have a value for "Default"
-					if (ittr.value().contains("Default"))
-					{
-						//If it does have a "Default" value then we should have the file no matter what
-						if (!unknown.contains(ittr.key()))
-						{
-							bad_files = true;
-							std::cout << "File missing: " << ittr.key() << std::endl;
-							continue;
-						}
-
-						//If the object has a "Default" hash and the file exists then check the value against the "Default" hash
-						if (unknown[ittr.key()] != ittr.value()["Default"])
-						{
-							bad_files = true;
-							std::cout << "Invalid File found: " << ittr.key() << std::endl;
-						}
+		//The launcher only needs the exit code
+		if (failFast)
+		{
+			std::cout << (bad_files ? "\nDamaged/missing files found" : "\nNo damaged/missing files found") << std::endl;
+			return bad_files ? EXIT_FAILURE : EXIT_SUCCESS;
+		}
 
-					}
-					else //If we have no default value this file only exists in the sdk and we should skip it since we dont have the sdk installed
-					{
-						continue;
-					}
-				}
-			}
-			else //If ittr is not an object this file should exist no matter if user has the sdk
-			{
-				if (unknown.contains(ittr.key())) //Do we have the ittr file
-				{
-					if (unknown[ittr.key()] != ittr.value()) //Since the file exists check that its valid
-					{
-						bad_files = true;
-						std::cout << "Invalid File found: " << ittr.key() << std::endl;
-					}
-				}
-				else
-				{
-					bad_files = true;
-					std::cout << "File missing: " << ittr.key() << std::endl;
-				}
-			}
+		//Saving unmaps the cache, map it again so the watcher can keep using it
+		if (useCache && watchMode)
+		{
+			hashCache.Load(cache_path);
 		}
 		
 		//Message
@@ -487,10 +2251,14 @@ int main()
 			std::cout << "\nFile Integrity check failed, damaged/missing files found :(\n" << std::endl;
 		}
 
+		if (watchMode && !metadataOnly)
+		{
+			WatchInstall(bHasSDK, cache_path);
+		}
+
 #ifdef BUILDER
 	}
 #endif // BUILDER
-	system("pause");
+	Pause();
 	return EXIT_SUCCESS;
 }
-
@@ -0,0 +1,193 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include "vpk-manifest.h"
+#include "Sha1.h"
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+//vpkentries.r5hv layout, all values are little endian
+//Header
+//Record[entryCount] sorted by archive path then packed path
+//Path bytes, each archive path is stored once and shared by its records
+struct VpkManifestHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t pathsSize;
+	//FNV-1a of everything after the header
+	uint64_t checksum;
+	uint64_t reserved;
+};
+
+struct VpkManifest::Record
+{
+	uint32_t archiveOffset;
+	uint16_t archiveLength;
+	uint16_t entryLength;
+	uint32_t entryOffset;
+	Digest digest;
+};
+
+static_assert(sizeof(VpkManifestHeader) == 32, "vpkentries.r5hv header layout changed");
+
+static const char vpkManifestMagic[4] = { 'R', '5', 'H', 'V' };
+static const uint32_t vpkManifestVersion = 1;
+
+bool VpkManifest::Load(const fs::path& path)
+{
+	static_assert(sizeof(Record) == 32, "vpkentries.r5hv record layout changed");
+
+	records = nullptr;
+	recordCount = 0;
+
+	if (!mapped.Open(path))
+	{
+		return false;
+	}
+
+	const unsigned char* data = mapped.Data();
+	const VpkManifestHeader* header = (const VpkManifestHeader*)data;
+
+	bool valid = mapped.Size() >= sizeof(VpkManifestHeader)
+		&& memcmp(header->magic, vpkManifestMagic, sizeof(vpkManifestMagic)) == 0
+		&& header->version == vpkManifestVersion
+		&& mapped.Size() == sizeof(VpkManifestHeader) + (size_t)header->entryCount * sizeof(Record) + header->pathsSize
+		&& header->checksum == Fnv1a(data + sizeof(VpkManifestHeader), mapped.Size() - sizeof(VpkManifestHeader));
+
+	if (!valid)
+	{
+		mapped.Close();
+		return false;
+	}
+
+	records = (const Record*)(data + sizeof(VpkManifestHeader));
+	recordCount = header->entryCount;
+	paths = (const char*)(records + recordCount);
+
+	//The checksum only catches damage, not a file that was written wrong
+	for (uint32_t i = 0; i < recordCount; i++)
+	{
+		if ((uint64_t)records[i].archiveOffset + records[i].archiveLength > header->pathsSize
+			|| (uint64_t)records[i].entryOffset + records[i].entryLength > header->pathsSize)
+		{
+			records = nullptr;
+			recordCount = 0;
+			mapped.Close();
+			return false;
+		}
+	}
+	return true;
+}
+
+void VpkManifest::Add(std::string_view archive, std::string_view entry, const Digest& digest)
+{
+	built.push_back({ std::string(archive), std::string(entry), digest });
+}
+
+bool VpkManifest::Write(const fs::path& path)
+{
+	std::sort(built.begin(), built.end(), [](const BuiltEntry& a, const BuiltEntry& b)
+	{
+		return std::tie(a.archive, a.entry) < std::tie(b.archive, b.entry);
+	});
+
+	std::vector<Record> entryRecords;
+	std::string allPaths;
+	std::map<std::string_view, uint32_t> archiveOffsets;
+
+	for (const BuiltEntry& entry : built)
+	{
+		//Record lengths are 16 bit, a longer path would be cut short
+		if (entry.archive.size() > UINT16_MAX || entry.entry.size() > UINT16_MAX)
+		{
+			return false;
+		}
+
+		auto archive = archiveOffsets.find(entry.archive);
+		if (archive == archiveOffsets.end())
+		{
+			archive = archiveOffsets.insert({ entry.archive, (uint32_t)allPaths.size() }).first;
+			allPaths += entry.archive;
+		}
+
+		Record record = {};
+		record.archiveOffset = archive->second;
+		record.archiveLength = (uint16_t)entry.archive.size();
+		record.entryOffset = (uint32_t)allPaths.size();
+		record.entryLength = (uint16_t)entry.entry.size();
+		record.digest = entry.digest;
+
+		entryRecords.push_back(record);
+		allPaths += entry.entry;
+	}
+
+	std::vector<unsigned char> out(sizeof(VpkManifestHeader));
+	out.insert(out.end(), (const unsigned char*)entryRecords.data(), (const unsigned char*)(entryRecords.data() + entryRecords.size()));
+	out.insert(out.end(), allPaths.begin(), allPaths.end());
+
+	VpkManifestHeader* header = (VpkManifestHeader*)out.data();
+	memcpy(header->magic, vpkManifestMagic, sizeof(vpkManifestMagic));
+	header->version = vpkManifestVersion;
+	header->entryCount = (uint32_t)entryRecords.size();
+	header->pathsSize = (uint32_t)allPaths.size();
+	header->checksum = Fnv1a(out.data() + sizeof(VpkManifestHeader), out.size() - sizeof(VpkManifestHeader));
+
+	return WriteFileAtomic(path, out.data(), out.size());
+}
+
+bool VpkManifest::Find(std::string_view archive, std::string_view entry, Digest& digest) const
+{
+	const Record* end = records + recordCount;
+	const Record* found = std::lower_bound(records, end, std::make_pair(archive, entry), [this](const Record& record, const std::pair<std::string_view, std::string_view>& value)
+	{
+		return std::make_pair(std::string_view(paths + record.archiveOffset, record.archiveLength), std::string_view(paths + record.entryOffset, record.entryLength)) < value;
+	});
+
+	if (found == end || Archive((uint32_t)(found - records)) != archive || Entry((uint32_t)(found - records)) != entry)
+	{
+		return false;
+	}
+
+	digest = found->digest;
+	return true;
+}
+
+std::string_view VpkManifest::Archive(uint32_t i) const
+{
+	return std::string_view(paths + records[i].archiveOffset, records[i].archiveLength);
+}
+
+std::string_view VpkManifest::Entry(uint32_t i) const
+{
+	return std::string_view(paths + records[i].entryOffset, records[i].entryLength);
+}
+
+const Digest& VpkManifest::EntryDigest(uint32_t i) const
+{
+	return records[i].digest;
+}
+
+bool HashVpkEntry(const VpkEntry& entry, const MappedFile& archive, Digest& digest)
+{
+	for (const VpkFragment& fragment : entry.fragments)
+	{
+		if (fragment.offset > archive.Size() || fragment.compressedSize > archive.Size() - fragment.offset)
+		{
+			return false;
+		}
+	}
+
+	CSha1* sha = new CSha1();
+	Sha1_Init(sha);
+	Sha1_Update(sha, (const unsigned char*)entry.preload.data(), entry.preload.size());
+
+	for (const VpkFragment& fragment : entry.fragments)
+	{
+		Sha1_Update(sha, archive.Data() + fragment.offset, (size_t)fragment.compressedSize);
+	}
+
+	Sha1_Final(sha, digest.bytes);
+	delete sha;
+	return true;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <experimental/filesystem>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "digest.h"
+#include "file-util.h"
+#include "vpk.h"
+
+namespace fs = std::experimental::filesystem;
+
+//Sha1 of every file packed in the VPK archives, written by builder mode with --vpk to vpkentries.r5hv
+//Lets the checker verify single packed files without reading the whole archive, see vpk-manifest.cpp for the layout
+class VpkManifest
+{
+public:
+	//Maps vpkentries.r5hv, returns false if it is missing or corrupt
+	bool Load(const fs::path& path);
+
+	//Adds a packed file while building, archive is the install path of the numbered archive holding it
+	void Add(std::string_view archive, std::string_view entry, const Digest& digest);
+	//Returns false without writing anything if a path is longer than 65535 bytes
+	bool Write(const fs::path& path);
+
+	//Returns false if the packed file is not listed
+	bool Find(std::string_view archive, std::string_view entry, Digest& digest) const;
+
+	//Packed files in archive then path order
+	uint32_t Count() const { return recordCount; }
+	std::string_view Archive(uint32_t i) const;
+	std::string_view Entry(uint32_t i) const;
+	const Digest& EntryDigest(uint32_t i) const;
+
+private:
+	struct Record;
+
+	struct BuiltEntry
+	{
+		std::string archive;
+		std::string entry;
+		Digest digest;
+	};
+
+	std::vector<BuiltEntry> built;
+
+	MappedFile mapped;
+	const Record* records = nullptr;
+	uint32_t recordCount = 0;
+	const char* paths = nullptr;
+};
+
+//Sha1 of a packed file as it is stored in its archive, compressed fragments are hashed without decompressing them
+//Returns false if a fragment is past the end of the archive
+bool HashVpkEntry(const VpkEntry& entry, const MappedFile& archive, Digest& digest);
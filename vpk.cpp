@@ -0,0 +1,365 @@
+#define _SILENCE_EXPERIMENTAL_FILESYSTEM_DEPRECATION_WARNING
+#include "vpk.h"
+#include "CpuArch.h"
+#include <zlib.h>
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#ifdef MY_CPU_X86_OR_AMD64
+#include <smmintrin.h>
+#include <wmmintrin.h>
+#endif
+
+//_dir.vpk layout, all values are little endian
+//Header
+//Tree of null terminated strings: for each extension, for each folder, for each file name an entry, each level ends with an empty string
+//Entry: uint32 crc, uint16 preload size, uint16 archive, then fragments each followed by uint16 0 if another fragment follows or 0xffff after the last
+//The preload bytes follow the entry
+struct VpkHeader
+{
+	uint32_t magic;
+	uint16_t majorVersion;
+	uint16_t minorVersion;
+	uint32_t treeSize;
+	uint32_t signatureSize;
+};
+
+static_assert(sizeof(VpkHeader) == 16, "VPK header layout changed");
+
+static const uint32_t vpkMagic = 0x55aa1234;
+static const uint16_t fragmentEnd = 0xffff;
+
+//Language prefixes of the directory files, the archives are shared between languages
+static const char* vpk_locales[]{ "english", "french", "german", "italian", "japanese", "korean", "mspanish", "polish", "portuguese", "russian", "schinese", "spanish", "tchinese" };
+
+//Bounds checked reads from the directory tree
+class TreeReader
+{
+public:
+	TreeReader(const unsigned char* data_in, size_t size_in) : data(data_in), size(size_in) {}
+
+	bool String(std::string_view& out)
+	{
+		const void* end = memchr(data + pos, 0, size - pos);
+		if (end == nullptr)
+		{
+			return false;
+		}
+
+		out = std::string_view((const char*)data + pos, (const unsigned char*)end - (data + pos));
+		pos += out.size() + 1;
+		return true;
+	}
+
+	template <typename T>
+	bool Read(T& out)
+	{
+		if (size - pos < sizeof(T))
+		{
+			return false;
+		}
+
+		memcpy(&out, data + pos, sizeof(T));
+		pos += sizeof(T);
+		return true;
+	}
+
+	bool Bytes(size_t count, std::string& out)
+	{
+		if (size - pos < count)
+		{
+			return false;
+		}
+
+		out.assign((const char*)data + pos, count);
+		pos += count;
+		return true;
+	}
+
+private:
+	const unsigned char* data;
+	size_t size;
+	size_t pos = 0;
+};
+
+static bool ReadEntry(TreeReader& tree, VpkEntry& entry)
+{
+	uint16_t preloadSize;
+	if (!tree.Read(entry.crc) || !tree.Read(preloadSize) || !tree.Read(entry.archive))
+	{
+		return false;
+	}
+
+	uint16_t marker = 0;
+	while (marker != fragmentEnd)
+	{
+		VpkFragment fragment;
+		if (!tree.Read(fragment.loadFlags) || !tree.Read(fragment.textureFlags) || !tree.Read(fragment.offset)
+			|| !tree.Read(fragment.compressedSize) || !tree.Read(fragment.uncompressedSize) || !tree.Read(marker))
+		{
+			return false;
+		}
+
+		if (marker != 0 && marker != fragmentEnd)
+		{
+			return false;
+		}
+		entry.fragments.push_back(fragment);
+	}
+
+	return tree.Bytes(preloadSize, entry.preload);
+}
+
+bool VpkEntry::Compressed() const
+{
+	for (const VpkFragment& fragment : fragments)
+	{
+		if (fragment.compressedSize != fragment.uncompressedSize)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool VpkDirectory::Load(const fs::path& path)
+{
+	entries.clear();
+
+	MappedFile mapped;
+	if (!mapped.Open(path) || mapped.Size() < sizeof(VpkHeader))
+	{
+		return false;
+	}
+
+	//Only the Respawn 2.3 format is read, its entries are split into fragments
+	const VpkHeader* header = (const VpkHeader*)mapped.Data();
+	if (header->magic != vpkMagic || header->majorVersion != 2 || header->minorVersion != 3 || header->treeSize > mapped.Size() - sizeof(VpkHeader))
+	{
+		return false;
+	}
+
+	TreeReader tree(mapped.Data() + sizeof(VpkHeader), header->treeSize);
+	std::string_view extension;
+	std::string_view folder;
+	std::string_view name;
+
+	while (true)
+	{
+		if (!tree.String(extension))
+		{
+			entries.clear();
+			return false;
+		}
+		if (extension.empty())
+		{
+			return true;
+		}
+
+		while (tree.String(folder) && !folder.empty())
+		{
+			while (tree.String(name) && !name.empty())
+			{
+				VpkEntry entry;
+
+				//A single space is the root folder
+				if (folder != " ")
+				{
+					entry.path.append(folder).append("/");
+				}
+				entry.path.append(name).append(".").append(extension);
+
+				if (!ReadEntry(tree, entry))
+				{
+					entries.clear();
+					return false;
+				}
+				entries.push_back(std::move(entry));
+			}
+		}
+	}
+}
+
+bool FindVpkDirectory(const fs::path& archive, fs::path& directory, uint16_t& index)
+{
+	std::string name = archive.filename().u8string();
+
+	//Archives end in _000.vpk, the number is the archive index
+	size_t length = strlen("_000.vpk");
+	if (name.size() <= length || name[name.size() - length] != '_' || name.compare(name.size() - 4, 4, ".vpk") != 0)
+	{
+		return false;
+	}
+
+	index = 0;
+	for (size_t i = name.size() - length + 1; i < name.size() - 4; i++)
+	{
+		if (name[i] < '0' || name[i] > '9')
+		{
+			return false;
+		}
+		index = (uint16_t)(index * 10 + (name[i] - '0'));
+	}
+
+	std::string base = name.substr(0, name.size() - length);
+
+	for (const char* locale : vpk_locales)
+	{
+		directory = archive.parent_path() / (locale + base + "_dir.vpk");
+		if (fs::exists(directory))
+		{
+			return true;
+		}
+	}
+
+	directory = archive.parent_path() / (base + "_dir.vpk");
+	return fs::exists(directory);
+}
+
+VpkCheck CheckVpkEntry(const VpkEntry& entry, const MappedFile& archive)
+{
+	for (const VpkFragment& fragment : entry.fragments)
+	{
+		if (fragment.offset > archive.Size() || fragment.compressedSize > archive.Size() - fragment.offset)
+		{
+			return VpkCheck::Damaged;
+		}
+	}
+
+	if (entry.Compressed())
+	{
+		return VpkCheck::Unchecked;
+	}
+
+	uint32_t crc = Crc32(0, (const unsigned char*)entry.preload.data(), entry.preload.size());
+	for (const VpkFragment& fragment : entry.fragments)
+	{
+		crc = Crc32(crc, archive.Data() + fragment.offset, (size_t)fragment.compressedSize);
+	}
+
+	return crc == entry.crc ? VpkCheck::Ok : VpkCheck::Damaged;
+}
+
+bool VpkEntryOverlaps(const VpkEntry& entry, uint64_t begin, uint64_t end)
+{
+	for (const VpkFragment& fragment : entry.fragments)
+	{
+		if (fragment.offset < end && begin < fragment.offset + fragment.compressedSize)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+#ifdef MY_CPU_X86_OR_AMD64
+//Folds 64 bytes at a time with carry-less multiplication then Barrett reduces to 32 bits, see Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ"
+//size must be at least 64 and a multiple of 16, crc is the inverted running value
+static uint32_t Crc32Clmul(uint32_t crc, const unsigned char* data, size_t size)
+{
+	alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+	alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+	alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+	alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+	__m128i x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+	__m128i x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+	__m128i x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+	__m128i x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+
+	__m128i k = _mm_load_si128((const __m128i*)k1k2);
+	data += 64;
+	size -= 64;
+
+	while (size >= 64)
+	{
+		__m128i x5 = _mm_clmulepi64_si128(x1, k, 0x00);
+		__m128i x6 = _mm_clmulepi64_si128(x2, k, 0x00);
+		__m128i x7 = _mm_clmulepi64_si128(x3, k, 0x00);
+		__m128i x8 = _mm_clmulepi64_si128(x4, k, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k, 0x11);
+
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(data + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(data + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(data + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(data + 0x30)));
+
+		data += 64;
+		size -= 64;
+	}
+
+	//Fold the four lanes into one
+	k = _mm_load_si128((const __m128i*)k3k4);
+	for (__m128i next : { x2, x3, x4 })
+	{
+		__m128i low = _mm_clmulepi64_si128(x1, k, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, next), low);
+	}
+
+	while (size >= 16)
+	{
+		__m128i low = _mm_clmulepi64_si128(x1, k, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)data)), low);
+
+		data += 16;
+		size -= 16;
+	}
+
+	//Fold 128 bits to 64
+	__m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i x0 = _mm_clmulepi64_si128(x1, k, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x0);
+
+	k = _mm_loadl_epi64((const __m128i*)k5k0);
+	x0 = _mm_srli_si128(x1, 4);
+	x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k, 0x00);
+	x1 = _mm_xor_si128(x1, x0);
+
+	//Barrett reduce to 32 bits
+	k = _mm_load_si128((const __m128i*)poly);
+	x0 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k, 0x10);
+	x0 = _mm_clmulepi64_si128(_mm_and_si128(x0, mask), k, 0x00);
+	x1 = _mm_xor_si128(x1, x0);
+
+	return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static bool HasClmul()
+{
+	//PCLMULQDQ and SSE4.1
+	Cx86cpuid cpu;
+	return x86cpuid_CheckAndRead(&cpu) && (cpu.c & (1 << 1)) && (cpu.c & (1 << 19));
+}
+#endif
+
+uint32_t Crc32(uint32_t crc, const unsigned char* data, size_t size)
+{
+#ifdef MY_CPU_X86_OR_AMD64
+	static const bool clmul = HasClmul();
+
+	if (clmul && size >= 64)
+	{
+		size_t folded = size & ~(size_t)15;
+		crc = ~Crc32Clmul(~crc, data, folded);
+		data += folded;
+		size -= folded;
+	}
+#endif
+
+	//zlib takes the length as a uInt so very large buffers are passed in pieces
+	while (size != 0)
+	{
+		uInt piece = (uInt)std::min<size_t>(size, 0x40000000);
+		crc = (uint32_t)crc32(crc, data, piece);
+		data += piece;
+		size -= piece;
+	}
+	return crc;
+}
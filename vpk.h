@@ -0,0 +1,68 @@
+#pragma once
+#include <experimental/filesystem>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "file-util.h"
+
+namespace fs = std::experimental::filesystem;
+
+//Part of a packed file stored in one of the numbered archives
+struct VpkFragment
+{
+	uint32_t loadFlags;
+	uint16_t textureFlags;
+	uint64_t offset;
+	uint64_t compressedSize;
+	uint64_t uncompressedSize;
+};
+
+//A file packed into a VPK, crc is of the whole uncompressed file including the preload bytes
+struct VpkEntry
+{
+	std::string path;
+	uint32_t crc;
+	uint16_t archive;
+	std::string preload;
+	std::vector<VpkFragment> fragments;
+
+	//Compressed fragments can not be checked against crc without decompressing them
+	bool Compressed() const;
+};
+
+//The _dir.vpk of a Respawn VPK, lists every packed file and where its data is stored
+class VpkDirectory
+{
+public:
+	//Reads a _dir.vpk, returns false if it is missing, corrupt or not a Respawn VPK
+	bool Load(const fs::path& path);
+
+	const std::vector<VpkEntry>& Entries() const { return entries; }
+
+private:
+	std::vector<VpkEntry> entries;
+};
+
+//Finds the _dir.vpk next to a numbered archive and which archive number it is
+//Returns false if archive is not a numbered VPK archive or has no directory
+bool FindVpkDirectory(const fs::path& archive, fs::path& directory, uint16_t& index);
+
+enum class VpkCheck
+{
+	Ok,
+	Damaged,
+	//The entry is compressed so its crc could not be checked
+	Unchecked
+};
+
+//Checks the data of entry in its mapped archive against the crc from the directory
+//Fragments past the end of the archive count as damaged
+VpkCheck CheckVpkEntry(const VpkEntry& entry, const MappedFile& archive);
+
+//True if any fragment of entry overlaps [begin, end) of its archive
+bool VpkEntryOverlaps(const VpkEntry& entry, uint64_t begin, uint64_t end);
+
+//The crc32 used by VPK and zip, continues from crc so data can be passed in pieces
+//Uses carry-less multiplication when the cpu has it
+uint32_t Crc32(uint32_t crc, const unsigned char* data, size_t size);
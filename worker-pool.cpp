@@ -0,0 +1,40 @@
+#include "worker-pool.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+void ParallelFor(size_t count, unsigned threads, const std::function<void(size_t)>& work, const std::atomic<bool>* cancel)
+{
+	if (threads == 0)
+	{
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = (unsigned)std::min<size_t>(threads, count);
+
+	std::atomic<size_t> next = 0;
+
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < count; i = next++)
+		{
+			if (cancel != nullptr && *cancel)
+			{
+				return;
+			}
+			work(i);
+		}
+	};
+
+	//The calling thread works too instead of waiting
+	std::vector<std::thread> pool;
+	for (unsigned i = 1; i < threads; i++)
+	{
+		pool.emplace_back(worker);
+	}
+	worker();
+
+	for (std::thread& thread : pool)
+	{
+		thread.join();
+	}
+}
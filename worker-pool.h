@@ -0,0 +1,9 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+//Calls work(i) for every i below count, spread over threads threads or one per core if threads is 0
+//Items are handed out in order so the first items finish first, returns once every item is done
+//Once cancel is set no more items are started, items already running are expected to check it themselves
+void ParallelFor(size_t count, unsigned threads, const std::function<void(size_t)>& work, const std::atomic<bool>* cancel = nullptr);